@@ -0,0 +1,23 @@
+mov x0, 0
+mov x5, 3
+loop:
+bl inc
+subs x5, x5, 1
+b.ne loop
+bl outer
+bl here
+here:
+add x7, x30, 12
+br x7
+mov x1, 99
+add x2, x0, 1
+hlt 0
+inc:
+add x0, x0, 1
+br x30
+outer:
+add x19, x30, 0
+bl inc
+bl inc
+add x30, x19, 0
+br x30
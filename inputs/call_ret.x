@@ -0,0 +1,19 @@
+d2800000 
+d2800065 
+9400000a 
+f10004a5 
+54ffffc1 
+94000009 
+94000001 
+910033c7 
+d61f00e0 
+d2800c61 
+91000402 
+d4400000 
+91000400 
+d61f03c0 
+910003d3 
+97fffffd 
+97fffffc 
+9100027e 
+d61f03c0 
\ No newline at end of file
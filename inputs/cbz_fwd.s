@@ -0,0 +1,26 @@
+mov x10, 40
+add x20, x10, x10
+cbz x20, skip1
+add x21, x20, 7
+skip1:
+lsl x22, x10, 1
+cbz x22, skip2
+add x23, x22, 1
+skip2:
+sub x24, x10, x10
+add x1, x1, 1
+cbnz x24, skip3
+add x25, x10, 2
+skip3:
+mov x9, 0x1000
+lsl x9, x9, 16
+stur x10, [x9, 0]
+ldur x26, [x9, 0]
+cbz x26, skip4
+add x27, x26, 3
+skip4:
+ldur x28, [x9, 8]
+cbnz x28, skip5
+add x29, x10, 4
+skip5:
+hlt 0
@@ -0,0 +1,21 @@
+d280050a 
+8b0a0154 
+b4000054 
+91001e95 
+d37ff956 
+b4000056 
+910006d7 
+cb0a0158 
+91000421 
+b5000058 
+91000959 
+d2820009 
+d370bd29 
+f800012a 
+f840013a 
+b400005a 
+91000f5b 
+f840813c 
+b500005c 
+9100115d 
+d4400000 
\ No newline at end of file
@@ -0,0 +1,2 @@
+run 40
+input 1 0x77
@@ -0,0 +1,303 @@
+mov x1, 5
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x2, x2, 1
+add x3, x1, 0
+hlt 0
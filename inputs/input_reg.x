@@ -0,0 +1,303 @@
+d28000a1 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000442 
+91000023 
+d4400000 
\ No newline at end of file
@@ -0,0 +1,29 @@
+mov x9, 0x1000
+lsl x9, x9, 16
+mov x1, 0x1234
+stur x1, [x9, 0]
+ldur x2, [x9, 0]
+mov x3, 0x56
+sturb w3, [x9, 4]
+ldur x4, [x9, 0]
+mov x5, 7
+stur x5, [x9, 8]
+mov x6, 9
+stur x6, [x9, 8]
+ldur x7, [x9, 8]
+ldur x8, [x9, 16]
+stur x2, [x9, 16]
+ldur x10, [x9, 16]
+add x11, x10, x4
+sturh w11, [x9, 24]
+ldurb w12, [x9, 24]
+ldurh w13, [x9, 24]
+mov x21, 4
+loop:
+ldur x22, [x9, 32]
+add x22, x22, x21
+stur x22, [x9, 32]
+subs x21, x21, 1
+b.ne loop
+ldur x23, [x9, 32]
+hlt 0
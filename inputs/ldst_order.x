@@ -0,0 +1,28 @@
+d2820009 
+d370bd29 
+d2824681 
+f8000121 
+f8400122 
+d2800ac3 
+38004123 
+f8400124 
+d28000e5 
+f8008125 
+d2800126 
+f8008126 
+f8408127 
+f8410128 
+f8010122 
+f841012a 
+8b04014b 
+7801812b 
+3841812c 
+7841812d 
+d2800095 
+f8420136 
+8b1502d6 
+f8020136 
+f10006b5 
+54ffff81 
+f8420137 
+d4400000 
\ No newline at end of file
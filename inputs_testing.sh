@@ -0,0 +1,40 @@
+#!/bin/bash
+# Run every inputs/*.x that has an inputs/*.rdump beside it through
+# src/sim under each machine configuration below, and compare the final
+# registers with the expected rdump. Both core models and a wide pipe
+# must give the same architectural result. The final PC is left out:
+# it is where fetch stopped, which depends on the model. An input with
+# an inputs/*.cmd beside it runs those shell commands before "go".
+# Run from the lab4/ directory after building src/sim (or set SIM).
+SIM=$(realpath "${SIM:-src/sim}")
+INPUTS=$(realpath inputs)
+
+declare -a configs=("" "-o core.model=ooo" "-o pipe.width=2" "-o core.model=ooo -o pipe.width=4"
+	"-o l1i.sets=2 -o l1i.ways=1 -o l1i.block=8 -o l1i.prefetch=nextline -o l1i.pf_degree=2")
+
+# the simulator writes dumpsim into its working directory
+workdir=$(mktemp -d)
+cd "$workdir"
+
+fail=0
+for expected in "$INPUTS"/*.rdump; do
+	inputfile=${expected%.rdump}.x
+	for opts in "${configs[@]}"; do
+		# inputs/NAME.cmd holds shell commands to run before "go"
+		cmds=${expected%.rdump}.cmd
+		{ [ -f "$cmds" ] && cat "$cmds"; printf "go\nrdump\n"; } |
+			timeout 10 "$SIM" $opts "$inputfile" |
+			grep -E "^(Instruction Retired|X[0-9]+:|FLAG_)" > actual.txt
+		if diff -q "$expected" actual.txt > /dev/null; then
+			echo "PASS $(basename "$inputfile") [$opts]"
+		else
+			echo "FAIL $(basename "$inputfile") [$opts]"
+			diff "$expected" actual.txt
+			fail=1
+		fi
+	done
+done
+
+cd - > /dev/null
+rm -rf "$workdir"
+exit $fail
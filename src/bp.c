@@ -7,92 +7,217 @@
 #include "bp.h"
 #include "stdbool.h"
 #include "shell.h"
+#include "checkpoint.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 
+uint32_t stat_br_cond = 0, stat_br_dir_miss = 0;
+uint32_t stat_br_ret = 0, stat_br_ret_miss = 0;
 
+void btb_init(bp_t* b, int sets, int ways, int tag_bits, int ras_entries)
+{
+    free(b->btb);
+    free(b->ras);
+    b->btb_sets = sets;
+    b->btb_ways = ways;
+    b->tag_bits = tag_bits;
+    b->btb_clock = 0;
+    b->btb = calloc((size_t)sets * ways, sizeof(BTB));
+    b->ras_entries = ras_entries;
+    b->ras_top = 0;
+    b->ras = calloc(ras_entries > 0 ? ras_entries : 1, sizeof(uint64_t));
+}
+
+static inline uint64_t *ras_slot(uint32_t n)
+{
+    return &bp->ras[n % bp->ras_entries];
+}
+
+static void ras_push(uint64_t addr)
+{
+    if (bp->ras_entries > 0) {
+        *ras_slot(bp->ras_top++) = addr;
+    }
+}
+
+// 0 when the stack is disabled or has nothing for us
+static uint64_t ras_pop()
+{
+    if (bp->ras_entries == 0 || bp->ras_top == 0) {
+        return 0;
+    }
+    return *ras_slot(--bp->ras_top);
+}
 
-uint64_t bp_predict(uint64_t PC, bool* hit)
+bp_snap bp_snapshot()
 {
-    bool conditional;
-    uint64_t btarget = query_btb(PC, &conditional);
+    bp_snap snap = { bp->dir->ghr, bp->ras_top, 0 };
+    if (bp->ras_entries > 0 && bp->ras_top > 0) {
+        snap.ras_tos = *ras_slot(bp->ras_top - 1);
+    }
+    return snap;
+}
+
+uint64_t bp_predict(uint64_t PC, bool* hit, bp_snap* snap)
+{
+    int kind;
+    *snap = bp_snapshot();
+    uint64_t btarget = query_btb(PC, &kind);
     //printf("bp_predict btarget: 0x%lx\n", btarget);
-    //printf("btb_conditional? %d, target = 0x%lx\n", conditional, btarget);
     if (btarget) {
         *hit = true;
-        if (!conditional || gshare_predict(PC)) {
-            //printf("predict branch_target: conditional: %d, gshare_prediction: %d\n", conditional, gshare_predict(PC));
-            return btarget;
-        } 
+        switch (kind) {
+            case BTB_COND:
+                if (bp_dir_predict(bp->dir, PC)) {
+                    return btarget;
+                }
+                break;
+            case BTB_CALL:
+                ras_push(PC + 4);
+                return btarget;
+            case BTB_RETURN: {
+                uint64_t ret = ras_pop();
+                return ret != 0 ? ret : btarget;
+            }
+            default:
+                return btarget;
+        }
     }
-    //printf("predict PC+4: conditional: %d, gshare_prediction: %d\n", conditional, gshare_predict(PC));
     return PC + 4;
 }
 
-void bp_update(uint64_t btarget, uint64_t PC, bool conditional, bool taken)
+void bp_update(uint64_t btarget, uint64_t PC, int kind, bool taken, const bp_snap* snap, bool redirect)
 {
-    update_btb(PC, btarget, conditional);
+    // A not-taken branch has no target to record, and writing one would
+    // wipe the target a BTB hit predicts with next time
+    if (taken) {
+        update_btb(PC, btarget, kind);
+    }
 
-    if (conditional) {
-        update_gshare_predictor(PC, taken);
+    if (kind == BTB_COND) {
+        bp_dir_update(bp->dir, PC, snap->hist, taken);
     }
 
+    if (redirect) {
+        bp_repair(PC, kind, taken, snap);
+    }
 }
 
-void update_gshare_predictor(uint64_t PC, int taken) {
-    // XOR the GHR with bits [9:2] of the PC to get the index into the PHT
-    unsigned char index = (bp->gshare->GHR ^ (PC >> 1)) & 0xFF;
+// Redo this branch's own call or return on top of the restored stack
+void bp_repair(uint64_t PC, int kind, bool taken, const bp_snap* snap)
+{
+    bp_restore(snap);
+    if (kind == BTB_COND) {
+        bp_dir_repair(bp->dir, snap->hist, taken);
+    } else if (kind == BTB_CALL) {
+        ras_push(PC + 4);
+    } else if (kind == BTB_RETURN) {
+        ras_pop();
+    }
+}
 
-    // Update the 2-bit saturating counter in the PHT
-    if (taken) {
-        if (bp->gshare->PHT[index] < 3) {
-            bp->gshare->PHT[index]++;
-        }
-    } else {
-        if (bp->gshare->PHT[index] > 0) {
-            bp->gshare->PHT[index]--;
-        }
+// Wrong-path predictions may have shifted the history, moved the
+// stack and overwritten its top
+void bp_restore(const bp_snap* snap)
+{
+    bp->dir->ghr = snap->hist;
+    bp->ras_top = snap->ras_top;
+    if (bp->ras_entries > 0 && snap->ras_top > 0) {
+        *ras_slot(snap->ras_top - 1) = snap->ras_tos;
     }
+}
 
-    // Update the GHR
-    bp->gshare->GHR = (bp->gshare->GHR << 1) | (taken & 0x1);
+static inline BTB* btb_set(uint64_t PC)
+{
+    return &bp->btb[((PC >> 2) & (bp->btb_sets - 1)) * bp->btb_ways];
 }
 
-bool gshare_predict(uint64_t PC) {
-    // XOR the GHR with bits [9:2] of the PC to get the index into the PHT
-    unsigned char index = (bp->gshare->GHR ^ (PC >> 1)) & 0xFF; // 8 bits
+static inline uint16_t btb_tag(uint64_t PC)
+{
+    return (PC >> (2 + __builtin_ctz(bp->btb_sets))) & ((1u << bp->tag_bits) - 1);
+}
 
-    // If the PHT entry is weakly taken (10) or strongly taken (11), predict taken
-    //printf ("ghare_predict PHT[%d] = %d\n", index, bp->gshare->PHT[index]);
-    return (bp->gshare->PHT[index] >= 2);
+// Refresh the entry for PC, or replace the least recently used way
+void update_btb(uint64_t PC, uint64_t btarget, int kind) {
+    BTB* set = btb_set(PC);
+    uint16_t tag = btb_tag(PC);
+    BTB* e = &set[0];
+    for (int w = 0; w < bp->btb_ways; w++) {
+        if (set[w].valid && set[w].tag == tag) {
+            e = &set[w];
+            break;
+        }
+        if (!set[w].valid || (e->valid && set[w].used < e->used)) {
+            e = &set[w];
+        }
+    }
+    e->valid = true;
+    e->tag = tag;
+    e->kind = kind;
+    e->btarget = btarget;
+    e->used = ++bp->btb_clock;
 }
 
-void update_btb(uint64_t PC, uint64_t btarget, bool conditional) {
-    // Index the BTB using bits [11:2] of the PC
-    unsigned int index = (PC >> 2) & 0x3FF; // 10 bits
+// Returns 0 if miss, else returns target address
+uint64_t query_btb(uint64_t PC, int* kind) {
+    BTB* set = btb_set(PC);
+    uint16_t tag = btb_tag(PC);
+    for (int w = 0; w < bp->btb_ways; w++) {
+        if (set[w].valid && set[w].tag == tag) {
+            set[w].used = ++bp->btb_clock;
+            *kind = set[w].kind;
+            return set[w].btarget;
+        }
+    }
+    *kind = BTB_JUMP;
+    return 0;
+}
 
-    // Update the BTB entry
-    bp->btb[index]->address_tag = PC;
-    bp->btb[index]->valid = true;
-    bp->btb[index]->conditional = conditional;
-    bp->btb[index]->btarget = btarget;
+// The direction predictor, BTB and RAS are rebuilt if the checkpoint
+// was taken with a different geometry.
+int bp_save(FILE* f) {
+    int32_t geom[7] = { bp->dir->kind, bp->dir->hist, bp->dir->bits,
+                        bp->btb_sets, bp->btb_ways, bp->tag_bits, bp->ras_entries };
+    int err = ckpt_write(f, geom, sizeof(geom));
+    err |= bp_dir_save(f, bp->dir);
+    err |= ckpt_write(f, bp->btb, (size_t)bp->btb_sets * bp->btb_ways * sizeof(BTB));
+    err |= ckpt_write(f, &bp->btb_clock, sizeof(bp->btb_clock));
+    err |= ckpt_write(f, bp->ras, bp->ras_entries * sizeof(uint64_t));
+    err |= ckpt_write(f, &bp->ras_top, sizeof(bp->ras_top));
+    err |= ckpt_write(f, &stat_br_cond, sizeof(stat_br_cond));
+    err |= ckpt_write(f, &stat_br_dir_miss, sizeof(stat_br_dir_miss));
+    err |= ckpt_write(f, &stat_br_ret, sizeof(stat_br_ret));
+    err |= ckpt_write(f, &stat_br_ret_miss, sizeof(stat_br_ret_miss));
+    return err;
 }
 
-// Returns 0 if miss, else returns target address
-uint64_t query_btb(uint64_t PC, bool *conditional) {
-    // Index the BTB using bits [11:2] of the PC
-    unsigned int index = (PC >> 2) & 0x3FF;
-
-    // misses in the BTB (i.e., address tag != PC or valid bit == 0),
-    if (bp->btb[index]->valid && bp->btb[index]->address_tag == PC) {
-        *conditional = bp->btb[index]->conditional;
-        //printf("BTB HIT\n");
-        return bp->btb[index]->btarget;
-    } else {
-        *conditional = 0;
-        //printf("BTB MISS\n");
-        return 0;
+int bp_load(FILE* f) {
+    int32_t geom[7];
+    if (ckpt_read(f, geom, sizeof(geom)) < 0 || geom[0] < 0 || geom[0] >= NUM_BP_DIR ||
+            geom[1] < 0 || geom[1] > BP_MAX_HIST || geom[2] < BP_MIN_BITS || geom[2] > BP_MAX_BITS ||
+            geom[3] < 1 || geom[3] > BTB_MAX_SETS || (geom[3] & (geom[3] - 1)) != 0 ||
+            geom[4] < 1 || geom[4] > BTB_MAX_WAYS || geom[5] < 1 || geom[5] > BTB_MAX_TAG_BITS ||
+            geom[6] < 0 || geom[6] > RAS_MAX_ENTRIES) {
+        return -1;
+    }
+    if (geom[0] != bp->dir->kind || geom[1] != bp->dir->hist || geom[2] != bp->dir->bits) {
+        bp_dir_free(bp->dir);
+        bp->dir = bp_dir_new(geom[0], geom[1], geom[2]);
+    }
+    if (geom[3] != bp->btb_sets || geom[4] != bp->btb_ways || geom[5] != bp->tag_bits ||
+            geom[6] != bp->ras_entries) {
+        btb_init(bp, geom[3], geom[4], geom[5], geom[6]);
     }
+    int err = bp_dir_load(f, bp->dir);
+    err |= ckpt_read(f, bp->btb, (size_t)bp->btb_sets * bp->btb_ways * sizeof(BTB));
+    err |= ckpt_read(f, &bp->btb_clock, sizeof(bp->btb_clock));
+    err |= ckpt_read(f, bp->ras, bp->ras_entries * sizeof(uint64_t));
+    err |= ckpt_read(f, &bp->ras_top, sizeof(bp->ras_top));
+    err |= ckpt_read(f, &stat_br_cond, sizeof(stat_br_cond));
+    err |= ckpt_read(f, &stat_br_dir_miss, sizeof(stat_br_dir_miss));
+    err |= ckpt_read(f, &stat_br_ret, sizeof(stat_br_ret));
+    err |= ckpt_read(f, &stat_br_ret_miss, sizeof(stat_br_ret_miss));
+    return err;
 }
@@ -7,36 +7,85 @@
 #include "stdbool.h"
 #include "shell.h"
 #include <limits.h>
+#include <stdio.h>
+#include "bpdir.h"
 
 #ifndef _BP_H_
 #define _BP_H_
 
 
 
-typedef struct {
-    unsigned char GHR;
-    unsigned char PHT[256];
-} GSHARE;
+#define BTB_MAX_SETS (1 << 16)
+#define BTB_MAX_WAYS 16
+#define BTB_MAX_TAG_BITS 16
+#define RAS_MAX_ENTRIES 64
+
+// What a BTB entry tells fetch to do besides jump to its target
+typedef enum {
+    BTB_JUMP, // B, or BR to anything but X30
+    BTB_COND, // ask the direction predictor
+    BTB_CALL, // BL: push the return address
+    BTB_RETURN, // BR X30: pop the return address instead
+} btb_kind;
 
 typedef struct {
     bool valid;
-    bool conditional; // 1: conditional, 0: unconditional
-    uint64_t address_tag; // Full Fetch PC
+    uint8_t kind; // btb_kind
+    uint16_t tag; // PC bits above the set index, btb.tag_bits of them
+    uint32_t used; // LRU stamp
     uint64_t btarget; // Branch target (last two bits = 00)
 } BTB;
 
+// Predictor state a fetch saw, kept with the instruction so that a
+// redirect can put things back the way they were
+typedef struct {
+    uint64_t hist; // direction history
+    uint32_t ras_top; // RAS push count
+    uint64_t ras_tos; // RAS top entry
+} bp_snap;
+
 typedef struct bp_t {
-    GSHARE* gshare;
-    BTB* btb[1024];
+    bp_dir* dir; // direction predictor for conditional branches
+    BTB* btb; // btb_sets * btb_ways entries, set by set
+    int btb_sets, btb_ways, tag_bits;
+    uint32_t btb_clock;
+    uint64_t* ras; // circular; the oldest entry is overwritten on overflow
+    int ras_entries;
+    uint32_t ras_top;
 } bp_t;
 extern bp_t* bp;
 
-uint64_t bp_predict(uint64_t PC, bool* hit);
-void bp_update(uint64_t btarget, uint64_t PC, bool conditional, bool taken);
+/* conditional branches resolved in EX and how many of them fetch
+   predicted in the wrong direction; likewise returns and wrong targets */
+extern uint32_t stat_br_cond, stat_br_dir_miss;
+extern uint32_t stat_br_ret, stat_br_ret_miss;
+
+/* (re)allocate an empty BTB and RAS of the given geometry */
+void btb_init(bp_t* b, int sets, int ways, int tag_bits, int ras_entries);
+
+bp_snap bp_snapshot();
+
+/* next fetch PC; *snap gets the state the prediction started from */
+uint64_t bp_predict(uint64_t PC, bool* hit, bp_snap* snap);
+
+/* train on a branch predicted from snap. redirect means fetch is being
+   steered off the predicted path, so the speculative history and
+   return stack are rebuilt from snap */
+void bp_update(uint64_t btarget, uint64_t PC, int kind, bool taken, const bp_snap* snap, bool redirect);
+
+/* the redirect half of bp_update on its own, for a core that resolves
+   branches before it trains on them */
+void bp_repair(uint64_t PC, int kind, bool taken, const bp_snap* snap);
+
+/* put the speculative state back as it was at snap, for a redirect
+   that is not a branch's own */
+void bp_restore(const bp_snap* snap);
+
+/* checkpoint hooks */
+int bp_save(FILE* f);
+int bp_load(FILE* f);
 
-void update_gshare_predictor(uint64_t PC, int taken);
-bool gshare_predict(uint64_t PC);
-void update_btb(uint64_t PC, uint64_t btarget, bool conditional);
-uint64_t query_btb(uint64_t PC, bool *conditional);
+void update_btb(uint64_t PC, uint64_t btarget, int kind);
+uint64_t query_btb(uint64_t PC, int* kind);
 
 #endif
@@ -0,0 +1,314 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "bpdir.h"
+#include "checkpoint.h"
+#include <stdlib.h>
+
+const char* const bp_dir_names[NUM_BP_DIR + 1] = {
+    "bimodal", "gshare", "tournament", "tage", "perceptron", NULL
+};
+
+#define ENTRIES(d) (1u << (d)->bits)
+#define MASK(d) (ENTRIES(d) - 1)
+
+// 2-bit saturating counter, taken at 2 and above
+static inline void ctr2_update(uint8_t* c, bool taken) {
+    if (taken) {
+        if (*c < 3) {
+            (*c)++;
+        }
+    } else if (*c > 0) {
+        (*c)--;
+    }
+}
+
+// XOR the newest len history bits down to `bits` bits
+static uint32_t fold(uint64_t ghr, int len, int bits) {
+    uint64_t h = len >= 64 ? ghr : ghr & ((1ULL << len) - 1);
+    uint32_t f = 0;
+    while (h != 0) {
+        f ^= h & ((1u << bits) - 1);
+        h >>= bits;
+    }
+    return f;
+}
+
+/* bimodal: uint8_t ctr[N] */
+
+static inline uint32_t bimodal_index(const bp_dir* d, uint64_t pc) {
+    return (pc >> 2) & MASK(d);
+}
+
+static bool bimodal_predict(bp_dir* d, uint64_t pc, uint64_t h) {
+    return d->table[bimodal_index(d, pc)] >= 2;
+}
+
+static void bimodal_update(bp_dir* d, uint64_t pc, uint64_t h, bool taken) {
+    ctr2_update(&d->table[bimodal_index(d, pc)], taken);
+}
+
+/* gshare: uint8_t pht[N]. PC >> 1 matches the original 256-entry
+   table, so the defaults index exactly as before. */
+
+static inline uint32_t gshare_index(const bp_dir* d, uint64_t pc, uint64_t h) {
+    return (fold(h, d->hist, d->bits) ^ (pc >> 1)) & MASK(d);
+}
+
+static bool gshare_predict(bp_dir* d, uint64_t pc, uint64_t h) {
+    return d->table[gshare_index(d, pc, h)] >= 2;
+}
+
+static void gshare_update(bp_dir* d, uint64_t pc, uint64_t h, bool taken) {
+    ctr2_update(&d->table[gshare_index(d, pc, h)], taken);
+}
+
+/* tournament: uint8_t local[N], global[N], chooser[N]; the chooser
+   counts towards the global side */
+
+static bool tournament_predict(bp_dir* d, uint64_t pc, uint64_t h) {
+    uint32_t i = bimodal_index(d, pc);
+    if (d->table[2 * ENTRIES(d) + i] >= 2) {
+        return d->table[ENTRIES(d) + gshare_index(d, pc, h)] >= 2;
+    }
+    return d->table[i] >= 2;
+}
+
+static void tournament_update(bp_dir* d, uint64_t pc, uint64_t h, bool taken) {
+    uint32_t i = bimodal_index(d, pc);
+    uint8_t* local = &d->table[i];
+    uint8_t* global = &d->table[ENTRIES(d) + gshare_index(d, pc, h)];
+    bool lp = *local >= 2;
+    bool gp = *global >= 2;
+    if (lp != gp) {
+        ctr2_update(&d->table[2 * ENTRIES(d) + i], gp == taken);
+    }
+    ctr2_update(local, taken);
+    ctr2_update(global, taken);
+}
+
+/* TAGE: uint8_t base[N], then TAGE_TABLES tables of N tage_entry.
+   Table i is indexed and tagged with the newest tage_hist[i] history
+   bits; the longest matching table provides the prediction. */
+
+#define TAGE_TABLES 4
+#define TAGE_TAG_BITS 8
+#define TAGE_VALID 0x100 // set in tag once the entry has been allocated
+#define TAGE_U_RESET (1u << 18) // updates between usefulness decays
+
+static const int tage_hist[TAGE_TABLES] = { 5, 12, 27, 60 };
+
+typedef struct {
+    uint16_t tag;
+    int8_t ctr; // -4..3, taken when >= 0
+    uint8_t u; // 0..3 usefulness
+} tage_entry;
+
+static inline tage_entry* tage_table(bp_dir* d, int t) {
+    return (tage_entry*)(d->table + ENTRIES(d)) + (size_t)t * ENTRIES(d);
+}
+
+static inline uint32_t tage_index(const bp_dir* d, uint64_t pc, uint64_t h, int t) {
+    return ((pc >> 2) ^ (pc >> (2 + d->bits)) ^ fold(h, tage_hist[t], d->bits) ^ t) & MASK(d);
+}
+
+static inline uint16_t tage_tag(const bp_dir* d, uint64_t pc, uint64_t h, int t) {
+    uint32_t f = fold(h, tage_hist[t], TAGE_TAG_BITS) ^
+                 (fold(h, tage_hist[t], TAGE_TAG_BITS - 1) << 1);
+    return TAGE_VALID | (((pc >> 2) ^ f) & ((1u << TAGE_TAG_BITS) - 1));
+}
+
+// Provider (longest match) and alternate (next longest) entries, NULL
+// where there is none
+static void tage_lookup(bp_dir* d, uint64_t pc, uint64_t h, tage_entry** prov, tage_entry** alt, int* prov_t) {
+    *prov = *alt = NULL;
+    *prov_t = -1;
+    for (int t = TAGE_TABLES - 1; t >= 0; t--) {
+        tage_entry* e = &tage_table(d, t)[tage_index(d, pc, h, t)];
+        if (e->tag != tage_tag(d, pc, h, t)) {
+            continue;
+        }
+        if (*prov == NULL) {
+            *prov = e;
+            *prov_t = t;
+        } else {
+            *alt = e;
+            return;
+        }
+    }
+}
+
+static bool tage_predict(bp_dir* d, uint64_t pc, uint64_t h) {
+    tage_entry *prov, *alt;
+    int t;
+    tage_lookup(d, pc, h, &prov, &alt, &t);
+    if (prov != NULL) {
+        return prov->ctr >= 0;
+    }
+    return d->table[bimodal_index(d, pc)] >= 2;
+}
+
+static void tage_update(bp_dir* d, uint64_t pc, uint64_t h, bool taken) {
+    tage_entry *prov, *alt;
+    int prov_t;
+    tage_lookup(d, pc, h, &prov, &alt, &prov_t);
+    uint8_t* base = &d->table[bimodal_index(d, pc)];
+    bool alt_pred = alt != NULL ? alt->ctr >= 0 : *base >= 2;
+    bool pred = prov != NULL ? prov->ctr >= 0 : *base >= 2;
+
+    if (prov != NULL) {
+        if (taken && prov->ctr < 3) {
+            prov->ctr++;
+        } else if (!taken && prov->ctr > -4) {
+            prov->ctr--;
+        }
+        if (pred != alt_pred) {
+            if (pred == taken && prov->u < 3) {
+                prov->u++;
+            } else if (pred != taken && prov->u > 0) {
+                prov->u--;
+            }
+        }
+        if (alt == NULL) {
+            ctr2_update(base, taken);
+        }
+    } else {
+        ctr2_update(base, taken);
+    }
+
+    // On a misprediction, claim an unused entry in a longer table;
+    // if every candidate is useful, age them instead
+    if (pred != taken && prov_t < TAGE_TABLES - 1) {
+        bool allocated = false;
+        for (int t = prov_t + 1; t < TAGE_TABLES; t++) {
+            tage_entry* e = &tage_table(d, t)[tage_index(d, pc, h, t)];
+            if (e->u == 0) {
+                e->tag = tage_tag(d, pc, h, t);
+                e->ctr = taken ? 0 : -1;
+                allocated = true;
+                break;
+            }
+        }
+        for (int t = prov_t + 1; !allocated && t < TAGE_TABLES; t++) {
+            tage_entry* e = &tage_table(d, t)[tage_index(d, pc, h, t)];
+            e->u--;
+        }
+    }
+    if (++d->updates % TAGE_U_RESET == 0) {
+        for (int t = 0; t < TAGE_TABLES; t++) {
+            for (uint32_t i = 0; i < ENTRIES(d); i++) {
+                tage_table(d, t)[i].u >>= 1;
+            }
+        }
+    }
+}
+
+/* perceptron: int8_t w[N][hist + 1], bias first */
+
+static int perceptron_output(bp_dir* d, uint64_t pc, uint64_t h, int8_t** row) {
+    int8_t* w = (int8_t*)d->table + (size_t)bimodal_index(d, pc) * (d->hist + 1);
+    int y = w[0];
+    for (int i = 0; i < d->hist; i++) {
+        y += (h >> i) & 1 ? w[i + 1] : -w[i + 1];
+    }
+    *row = w;
+    return y;
+}
+
+static bool perceptron_predict(bp_dir* d, uint64_t pc, uint64_t h) {
+    int8_t* w;
+    return perceptron_output(d, pc, h, &w) >= 0;
+}
+
+static inline void weight_add(int8_t* w, int delta) {
+    int v = *w + delta;
+    *w = v > 127 ? 127 : v < -127 ? -127 : v;
+}
+
+// Train on a misprediction or while the output is below the usual
+// 1.93 * h + 14 threshold
+static void perceptron_update(bp_dir* d, uint64_t pc, uint64_t h, bool taken) {
+    int8_t* w;
+    int y = perceptron_output(d, pc, h, &w);
+    int theta = (193 * d->hist) / 100 + 14;
+    if ((y >= 0) == taken && abs(y) > theta) {
+        return;
+    }
+    int t = taken ? 1 : -1;
+    weight_add(&w[0], t);
+    for (int i = 0; i < d->hist; i++) {
+        weight_add(&w[i + 1], (h >> i) & 1 ? t : -t);
+    }
+}
+
+// Indexed by bp_dir_kind. size gives the bytes of table state for a
+// geometry; every table starts zeroed. predict and update index with
+// the history they are handed rather than the live register.
+typedef struct {
+    size_t (*size)(int hist, int bits);
+    bool (*predict)(bp_dir* d, uint64_t pc, uint64_t h);
+    void (*update)(bp_dir* d, uint64_t pc, uint64_t h, bool taken);
+} bp_dir_ops;
+
+static size_t counters_size(int hist, int bits) { return (size_t)1 << bits; }
+static size_t tournament_size(int hist, int bits) { return (size_t)3 << bits; }
+static size_t tage_size(int hist, int bits) {
+    return ((size_t)1 << bits) * (1 + TAGE_TABLES * sizeof(tage_entry));
+}
+static size_t perceptron_size(int hist, int bits) { return ((size_t)1 << bits) * (hist + 1); }
+
+static const bp_dir_ops bp_dir_table[NUM_BP_DIR] = {
+    [BP_BIMODAL]    = { counters_size,   bimodal_predict,    bimodal_update },
+    [BP_GSHARE]     = { counters_size,   gshare_predict,     gshare_update },
+    [BP_TOURNAMENT] = { tournament_size, tournament_predict, tournament_update },
+    [BP_TAGE]       = { tage_size,       tage_predict,       tage_update },
+    [BP_PERCEPTRON] = { perceptron_size, perceptron_predict, perceptron_update },
+};
+
+bp_dir* bp_dir_new(int kind, int hist, int bits) {
+    bp_dir* d = malloc(sizeof(bp_dir));
+    d->kind = kind;
+    d->hist = hist;
+    d->bits = bits;
+    d->ghr = 0;
+    d->updates = 0;
+    d->size = bp_dir_table[kind].size(hist, bits);
+    d->table = calloc(1, d->size);
+    return d;
+}
+
+void bp_dir_free(bp_dir* d) {
+    free(d->table);
+    free(d);
+}
+
+bool bp_dir_predict(bp_dir* d, uint64_t pc) {
+    bool taken = bp_dir_table[d->kind].predict(d, pc, d->ghr);
+    d->ghr = (d->ghr << 1) | taken;
+    return taken;
+}
+
+void bp_dir_update(bp_dir* d, uint64_t pc, uint64_t h, bool taken) {
+    bp_dir_table[d->kind].update(d, pc, h, taken);
+}
+
+void bp_dir_repair(bp_dir* d, uint64_t h, bool taken) {
+    d->ghr = (h << 1) | taken;
+}
+
+int bp_dir_save(FILE* f, const bp_dir* d) {
+    int err = ckpt_write(f, &d->ghr, sizeof(d->ghr));
+    err |= ckpt_write(f, &d->updates, sizeof(d->updates));
+    err |= ckpt_write(f, d->table, d->size);
+    return err;
+}
+
+int bp_dir_load(FILE* f, bp_dir* d) {
+    int err = ckpt_read(f, &d->ghr, sizeof(d->ghr));
+    err |= ckpt_read(f, &d->updates, sizeof(d->updates));
+    err |= ckpt_read(f, d->table, d->size);
+    return err;
+}
@@ -0,0 +1,63 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Conditional branch direction predictors, chosen at startup with
+ * bp.predictor. All of them share one global history register (newest
+ * outcome in bit 0) that each prediction shifts into speculatively. A
+ * branch keeps the history it was predicted with, trains with it when
+ * it resolves, and rebuilds the register from it when it redirects
+ * fetch. Tables hold 2^bp.bits entries; bp.hist is the history length
+ * for gshare, tournament and perceptron (TAGE uses its own geometric
+ * series).
+ */
+
+#ifndef _BPDIR_H_
+#define _BPDIR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    BP_BIMODAL,    // 2-bit counters indexed by PC
+    BP_GSHARE,     // 2-bit counters indexed by PC xor history
+    BP_TOURNAMENT, // bimodal vs gshare with a per-PC chooser
+    BP_TAGE,       // bimodal base plus tagged geometric-history tables
+    BP_PERCEPTRON, // one weight vector per PC over the history bits
+    NUM_BP_DIR
+} bp_dir_kind;
+
+extern const char* const bp_dir_names[NUM_BP_DIR + 1];
+
+#define BP_MAX_HIST 63
+#define BP_MIN_BITS 4
+#define BP_MAX_BITS 20
+
+typedef struct {
+    bp_dir_kind kind;
+    int hist; // history bits used
+    int bits; // log2 of the table size
+    uint64_t ghr; // speculative global history
+    size_t size; // bytes of table state
+    uint8_t* table; // layout depends on kind, see bpdir.c
+    uint32_t updates; // TAGE: drives the periodic usefulness reset
+} bp_dir;
+
+bp_dir* bp_dir_new(int kind, int hist, int bits);
+void bp_dir_free(bp_dir* d);
+/* predict with the current history and shift the prediction into it */
+bool bp_dir_predict(bp_dir* d, uint64_t pc);
+
+/* train on an outcome, indexing with the history h predicted with */
+void bp_dir_update(bp_dir* d, uint64_t pc, uint64_t h, bool taken);
+
+/* restart the history after a branch predicted with h resolved */
+void bp_dir_repair(bp_dir* d, uint64_t h, bool taken);
+
+/* checkpoint hooks; kind and geometry must already match */
+int bp_dir_save(FILE* f, const bp_dir* d);
+int bp_dir_load(FILE* f, bp_dir* d);
+
+#endif
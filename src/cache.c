@@ -9,91 +9,208 @@
 #include "shell.h"
 #include "pipe.h"
 #include "bp.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "mem.h"
+#include "config.h"
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
-cache_t *cache_new(int sets, int ways, int block)
-{
-    cache_t* cres = malloc(sizeof(cache_t));
-    cres->set = malloc(sets * sizeof(line_t*));
-    int i, j, k;
-    for (i = 0; i < sets; i++) {
-        cres->set[i] = malloc(ways * sizeof(line_t));
-        for (j = 0; j < ways; j++) {
-            cres->set[i][j].block = malloc((block/4) * sizeof(uint64_t));
-            for (k = 0; k < block/4; k++) {
-                cres->set[i][j].block[k] = 0;
-            }
-            cres->set[i][j].valid = 0;
-            cres->set[i][j].clock = 0;
-            cres->set[i][j].tag = 0;
+// Host allocation granularity for cache arenas; arenas of at least one
+// huge page are rounded up to CACHE_HUGE_PAGE and backed by huge pages
+// when the host allows it.
+#define CACHE_HOST_PAGE 4096
+#define CACHE_HUGE_PAGE (2u << 20)
+#define CACHE_ALIGN(x, a) (((x) + (a) - 1) & ~(size_t)((a) - 1))
+
+// Map a zero-filled arena of at least `size` bytes; *mapped gets the
+// length actually mapped. Tries explicit huge pages first, then falls
+// back to normal pages with a transparent-hugepage hint.
+static void* cache_arena_map(size_t size, size_t* mapped) {
+    void* p = MAP_FAILED;
+    if (size >= CACHE_HUGE_PAGE) {
+        size = CACHE_ALIGN(size, CACHE_HUGE_PAGE);
+#ifdef MAP_HUGETLB
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    } else {
+        size = CACHE_ALIGN(size, CACHE_HOST_PAGE);
+    }
+    if (p == MAP_FAILED) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if (size >= CACHE_HUGE_PAGE) {
+            madvise(p, size, MADV_HUGEPAGE);
         }
-        
+#endif
     }
+    *mapped = size;
+    return p;
+}
+
+// All of a cache's storage (tags, dirty masks, line data) is carved out
+// of one arena, each array starting on a host cache line. A fresh
+// mapping is already zero, so only the tags need filling.
+cache_t *cache_new(int sets, int ways, int block, int policy)
+{
+    cache_t* cres = malloc(sizeof(cache_t));
     cres->block_size = block;
     cres->set_no = sets;
     cres->ways = ways;
+    cres->stride = (ways + CACHE_TAG_LANES - 1) & ~(CACHE_TAG_LANES - 1);
+    cres->s = my_log2(sets);
+    cres->b = my_log2(block);
+    size_t tag_bytes = CACHE_ALIGN((size_t)sets * cres->stride * sizeof(uint64_t), 64);
+    size_t dirty_bytes = CACHE_ALIGN((size_t)sets * sizeof(uint64_t), 64);
+    size_t data_bytes = (size_t)sets * ways * block;
+    uint8_t* arena = cache_arena_map(tag_bytes + dirty_bytes + data_bytes, &cres->arena_size);
+    if (arena == NULL) {
+        printf("Error: cannot allocate %zu bytes of cache storage\n",
+               tag_bytes + dirty_bytes + data_bytes);
+        exit(-1);
+    }
+    cres->arena = arena;
+    cres->tags = (uint64_t*)arena;
+    cres->dirty = (uint64_t*)(arena + tag_bytes);
+    cres->data = arena + tag_bytes + dirty_bytes;
+    memset(cres->tags, 0xff, (size_t)sets * cres->stride * sizeof(uint64_t)); // CACHE_TAG_INVALID
+    cres->latency = 0;
+    cres->last_latency = 0;
+    cres->next = NULL;
+    cres->writebacks = 0;
+    repl_init(&cres->repl, policy, sets, ways);
     return cres;
 }
 
+// Drop every line without writing anything back. Replacement state is
+// rebuilt from scratch.
+void cache_reset(cache_t* c)
+{
+    memset(c->tags, 0xff, (size_t)c->set_no * c->stride * sizeof(uint64_t));
+    memset(c->dirty, 0, (size_t)c->set_no * sizeof(uint64_t));
+    memset(c->data, 0, (size_t)c->set_no * c->ways * c->block_size);
+    repl_t* r = &c->repl;
+    repl_policy policy = r->policy;
+    repl_free(r);
+    repl_init(r, policy, c->set_no, c->ways);
+}
+
 void cache_destroy(cache_t *c)
 {
-    int block = c->block_size;
-    int set_no = c->set_no;
-    int ways = c->ways;
-    int i, j;
-    for (i = 0; i < set_no; i++) {
-        for (j = 0; j < ways; j++) {
-            free(c->set[i][j].block);
+    munmap(c->arena, c->arena_size);
+    repl_free(&c->repl);
+    free(c);
+}
+
+static inline int cache_set_index(cache_t* c, uint64_t addr) {
+    return (addr >> c->b) & (c->set_no - 1);
+}
+
+static inline uint64_t cache_tag(cache_t* c, uint64_t addr) {
+    return addr >> (c->b + c->s);
+}
+
+static inline uint8_t* cache_line(cache_t* c, int set_i, int way) {
+    return c->data + (((size_t)set_i * c->ways + way) << c->b);
+}
+
+// Way of set_i holding tag, or -1. Compares CACHE_TAG_LANES tags per
+// step; empty and padding slots hold CACHE_TAG_INVALID, which no real
+// tag equals, so no separate valid check is needed.
+static inline int cache_match(cache_t* c, int set_i, uint64_t tag) {
+    const uint64_t* tags = c->tags + (size_t)set_i * c->stride;
+#ifdef __AVX2__
+    __m256i key = _mm256_set1_epi64x(tag);
+    for (int w = 0; w < c->stride; w += CACHE_TAG_LANES) {
+        __m256i t = _mm256_load_si256((const __m256i*)(tags + w));
+        int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(t, key)));
+        if (m) {
+            return w + __builtin_ctz(m);
         }
-        free(c->set[i]);
     }
-    free(c->set);
-    free(c);
+#else
+    typedef uint64_t tagvec __attribute__((vector_size(CACHE_TAG_LANES * sizeof(uint64_t))));
+    tagvec key = (tagvec){ 0 } + tag;
+    for (int w = 0; w < c->stride; w += CACHE_TAG_LANES) {
+        tagvec eq = *(const tagvec*)(tags + w) == key;
+        if (eq[0] | eq[1] | eq[2] | eq[3]) {
+            for (int i = 0; ; i++) {
+                if (eq[i]) {
+                    return w + i;
+                }
+            }
+        }
+    }
+#endif
+    return -1;
+}
+
+// Write a dirty line back to the next level and mark it clean.
+static void cache_writeback(cache_t* c, int set_i, int way) {
+    uint64_t addr = (c->tags[(size_t)set_i * c->stride + way] << (c->b + c->s)) |
+                    ((uint64_t)set_i << c->b);
+    cache_write(c->next, addr, cache_line(c, set_i, way), c->block_size);
+    c->dirty[set_i] &= ~(1ULL << way);
+    c->writebacks++;
+}
+
+// Look addr up without allocating or touching replacement state.
+// Returns 1 on a hit with *lineNo set to the way holding addr.
+int cache_probe(cache_t* c, uint64_t addr, int* lineNo) {
+    TRACE(TRACE_DETAIL, TRACE_CACHE, "Caching address: 0x%lx\n", addr);
+    int way = cache_match(c, cache_set_index(c, addr), cache_tag(c, addr));
+    if (way < 0) {
+        return 0;
+    }
+    *lineNo = way;
+    return 1;
 }
 
+// Look addr up, allocating it on a miss (write-allocate): the victim
+// chosen by the replacement policy is written back if dirty and refilled
+// through the next level, which allocates too. Returns 1 on a hit;
+// *lineNo is the way that now holds addr and c->last_latency the cycles
+// the access took.
 int cache_update(cache_t *c, uint64_t addr, int* lineNo)
 {
-    // How to know if in right set?
-    int i;
-    // What does return mean?
-    // Update if hit? Update if miss?
-    int s = my_log2(c->set_no);
-    int b = my_log2(c->block_size);
-    int block_offset = takebits64(addr, b-1, 0);
-    int set_i = takebits64(addr, b+s, b);
-    uint64_t addr_tag = takebits(addr, 63, b+s+1);
-    uint32_t LRU = 0xffffffff;
-    int LRU_line = 0;
+    int set_i = cache_set_index(c, addr);
+    uint64_t addr_tag = cache_tag(c, addr);
+    int victim;
     // CHECK HIT
-    //printf("ways: %d, set_ind(%d), block_offset(%d)\n", c->ways, set_i, block_offset);
-    printf("Caching address: 0x%lx\n", addr);
-    for (i = 0; i < c->ways; i++) {
-        //printf("test hit %d\n", i);
-        if (c->set[set_i][i].tag == addr_tag && c->set[set_i][i].valid == true) {
-            //printf("HIT: Set %d line %d\n", set_i, i);
-            //*set_index = set_i;
-            //printf("hit: cacheTag: %ld\n", c->set[set_i][i].tag);
-            return 1;
-            c->set[set_i][i].clock = stat_cycles;
-        }
+    TRACE(TRACE_DETAIL, TRACE_CACHE, "Caching address: 0x%lx\n", addr);
+    int way = cache_match(c, set_i, addr_tag);
+    if (way >= 0) {
+        *lineNo = way;
+        c->last_latency = c->latency;
+        repl_hit(&c->repl, set_i, way);
+        return 1;
     }
     // IF MISS
-    for (i = 0; i < c->ways; i++) {
-        if (c->set[set_i][i].clock < LRU) {
-            LRU = c->set[set_i][i].clock;
-            LRU_line = i;
-        }
+    victim = repl_victim(&c->repl, set_i);
+    *lineNo = victim;
+    if (c->dirty[set_i] & (1ULL << victim)) {
+        cache_writeback(c, set_i, victim);
     }
-    *lineNo = LRU_line;
-    //printf("LRU: Line %d\n", LRU_line);
-    c->set[set_i][LRU_line].valid = true;
-    c->set[set_i][LRU_line].tag = takebits64(addr, 63, b+s+1);
-    c->set[set_i][LRU_line].clock = stat_cycles;
-    for (i = 0; i < c->block_size/4; i++) {
-        c->set[set_i][LRU_line].block[i] = mem_read_32(addr+(i*4));
+    c->tags[(size_t)set_i * c->stride + victim] = addr_tag;
+    repl_fill(&c->repl, set_i, victim);
+    if (c->next != NULL) {
+        int next_line;
+        cache_update(c->next, addr, &next_line);
+        c->last_latency = c->latency + c->next->last_latency;
+    } else {
+        c->last_latency = c->latency + config.mem_latency;
     }
+    cache_read(c->next, addr & ~(uint64_t)(c->block_size - 1), cache_line(c, set_i, victim), c->block_size);
     return 0;
 }
 
@@ -102,20 +219,134 @@ int cache_compare(cache_t* c, uint64_t add1, uint64_t add2) {
     return ((add1 >> b) == (add2 >> b));
 }
 void cache_remove(cache_t* c, uint64_t address, int line) {
-    int s = my_log2(c->set_no);
-    int b = my_log2(c->block_size);
-    int block_offset = takebits64(address, b-1, 0);
-    int set_i = takebits64(address, b+s, b);
-    for (int i = 0; i < c->block_size/4; i++) {
-        c->set[set_i][line].block[i] = 0;
+    int set_i = cache_set_index(c, address);
+    if (c->dirty[set_i] & (1ULL << line)) {
+        cache_writeback(c, set_i, line);
+    }
+    memset(cache_line(c, set_i, line), 0, c->block_size);
+    c->tags[(size_t)set_i * c->stride + line] = CACHE_TAG_INVALID;
+    repl_invalidate(&c->repl, set_i, line);
+}
+
+// Pointer to the bytes of addr inside way `line` of its set, for a line
+// cache_update just returned.
+uint8_t* cache_data(cache_t* c, uint64_t addr, int line) {
+    return cache_line(c, cache_set_index(c, addr), line) + (addr & (c->block_size - 1));
+}
+
+// Copy n bytes at addr out of the cache, line by line. Parts that are
+// not resident come from the next level; a NULL cache is main memory.
+void cache_read(cache_t* c, uint64_t addr, void* dst, int n) {
+    uint8_t* out = dst;
+    if (c == NULL) {
+        mem_read_block(addr, dst, n);
+        return;
+    }
+    while (n > 0) {
+        int off = addr & (c->block_size - 1);
+        int chunk = n < c->block_size - off ? n : c->block_size - off;
+        int set_i = cache_set_index(c, addr);
+        int way = cache_match(c, set_i, cache_tag(c, addr));
+        if (way >= 0) {
+            memcpy(out, cache_line(c, set_i, way) + off, chunk);
+        } else {
+            cache_read(c->next, addr, out, chunk);
+        }
+        addr += chunk;
+        out += chunk;
+        n -= chunk;
     }
-    c->set[set_i][line].clock = 0;
-    c->set[set_i][line].valid = false;
-    c->set[set_i][line].tag = 0;
 }
 
-uint32_t cache_read(cache_t* c, uint64_t address, int set_index) {
-    printf("cache hit\n");
+// Store n bytes at addr: resident lines are updated and marked dirty,
+// anything else is passed on to the next level.
+void cache_write(cache_t* c, uint64_t addr, const void* src, int n) {
+    const uint8_t* in = src;
+    if (c == NULL) {
+        mem_write_block(addr, src, n);
+        return;
+    }
+    while (n > 0) {
+        int off = addr & (c->block_size - 1);
+        int chunk = n < c->block_size - off ? n : c->block_size - off;
+        int set_i = cache_set_index(c, addr);
+        int way = cache_match(c, set_i, cache_tag(c, addr));
+        if (way >= 0) {
+            memcpy(cache_line(c, set_i, way) + off, in, chunk);
+            c->dirty[set_i] |= 1ULL << way;
+        } else {
+            cache_write(c->next, addr, in, chunk);
+        }
+        addr += chunk;
+        in += chunk;
+        n -= chunk;
+    }
+}
+
+// Tags and dirty bits are written whole; data only for resident lines
+// (empty lines hold zeros).
+int cache_save(FILE* f, cache_t* c) {
+    int32_t geom[6] = { c != NULL, 0, 0, 0, 0, 0 };
+    if (c != NULL) {
+        geom[1] = c->set_no;
+        geom[2] = c->ways;
+        geom[3] = c->block_size;
+        geom[4] = c->latency;
+        geom[5] = c->repl.policy;
+    }
+    int err = ckpt_write(f, geom, sizeof(geom));
+    if (c == NULL) {
+        return err;
+    }
+    err |= ckpt_write(f, c->tags, (size_t)c->set_no * c->stride * sizeof(uint64_t));
+    err |= ckpt_write(f, c->dirty, c->set_no * sizeof(uint64_t));
+    for (int i = 0; i < c->set_no; i++) {
+        for (int j = 0; j < c->ways; j++) {
+            if (c->tags[(size_t)i * c->stride + j] != CACHE_TAG_INVALID) {
+                err |= ckpt_write(f, cache_line(c, i, j), c->block_size);
+            }
+        }
+    }
+    err |= repl_save(f, &c->repl);
+    return err;
+}
+
+// Restore into c, reallocating it when the saved geometry differs.
+// Returns the cache to use from now on (NULL if none was saved); the
+// caller relinks `next`.
+cache_t* cache_load(FILE* f, cache_t* c, int* err) {
+    int32_t geom[6];
+    if (ckpt_read(f, geom, sizeof(geom)) < 0 ||
+            (geom[0] && (geom[1] <= 0 || geom[2] <= 0 || geom[2] > REPL_MAX_WAYS ||
+                         geom[3] < 4 || geom[5] < 0 || geom[5] >= NUM_REPL))) {
+        *err = -1;
+        return c;
+    }
+    if (c != NULL && (!geom[0] || c->set_no != geom[1] ||
+            c->ways != geom[2] || c->block_size != geom[3] || c->repl.policy != geom[5])) {
+        cache_destroy(c);
+        c = NULL;
+    }
+    if (!geom[0]) {
+        return NULL;
+    }
+    if (c == NULL) {
+        c = cache_new(geom[1], geom[2], geom[3], geom[5]);
+    } else {
+        cache_reset(c);
+    }
+    c->latency = geom[4];
+    *err |= ckpt_read(f, c->tags, (size_t)c->set_no * c->stride * sizeof(uint64_t));
+    *err |= ckpt_read(f, c->dirty, c->set_no * sizeof(uint64_t));
+    for (int i = 0; i < c->set_no; i++) {
+        for (int j = 0; j < c->ways; j++) {
+            if (c->tags[(size_t)i * c->stride + j] != CACHE_TAG_INVALID) {
+                *err |= ckpt_read(f, cache_line(c, i, j), c->block_size);
+            }
+        }
+    }
+    *err |= repl_load(f, &c->repl);
+    return c;
 }
 
 uint64_t takebits64(uint64_t input, uint32_t a, uint32_t b) {
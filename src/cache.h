@@ -10,26 +10,52 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <math.h>
+#include <stdio.h>
+#include "repl.h"
 
-typedef struct {
-    bool valid;
-    uint32_t clock; // Age
-    uint64_t tag;
-    uint64_t* block;
-} line_t;
+// Tag store is structure-of-arrays: each set's tags are contiguous and
+// padded to a multiple of CACHE_TAG_LANES so a lookup compares several
+// ways per SIMD step. Tags, dirty masks and line data all live in one
+// mmap'd arena (see cache_new).
+#define CACHE_TAG_LANES   4
+#define CACHE_TAG_INVALID UINT64_MAX // empty way; never a real tag
 
-typedef struct {
-    line_t** set;
+typedef struct cache_t {
     int set_no;
     int block_size; // in bytes
     int ways;
+    int stride; // tag slots per set, ways rounded up to CACHE_TAG_LANES
+    int s, b; // log2(set_no), log2(block_size)
+    uint64_t* tags; // [set_no][stride]
+    uint64_t* dirty; // per set: bit w set when way w was written since fill
+    uint8_t* data; // [set_no][ways][block_size]
+    void* arena; // backing store for tags, dirty and data
+    size_t arena_size;
+    int latency; // extra cycles for a hit here
+    int last_latency; // cycles taken by the most recent cache_update
+    struct cache_t* next; // next level; NULL means main memory
+    uint32_t writebacks; // dirty lines written back to the next level
+    repl_t repl; // replacement state
 } cache_t;
 
+extern cache_t* iCache;
+extern cache_t* dCache;
+extern cache_t* l2Cache; // NULL unless l2.enable
+
 uint64_t takebits64(uint64_t input, uint32_t a, uint32_t b);
-cache_t *cache_new(int sets, int ways, int block);
+cache_t *cache_new(int sets, int ways, int block, int policy);
 void cache_destroy(cache_t *c);
+void cache_reset(cache_t *c);
+int cache_probe(cache_t* c, uint64_t addr, int* lineNo);
 int cache_update(cache_t *c, uint64_t addr, int* lineNo);
 int cache_compare(cache_t* c, uint64_t add1, uint64_t add2);
 void cache_remove(cache_t* c, uint64_t address, int line);
+uint8_t* cache_data(cache_t* c, uint64_t addr, int line);
+void cache_read(cache_t* c, uint64_t addr, void* dst, int n);
+void cache_write(cache_t* c, uint64_t addr, const void* src, int n);
 int my_log2(int n);
+
+/* checkpoint hooks; a NULL cache (iCache after halt) is saved as absent */
+int cache_save(FILE* f, cache_t* c);
+cache_t* cache_load(FILE* f, cache_t* c, int* err);
 #endif
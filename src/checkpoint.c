@@ -0,0 +1,130 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Whole-simulator snapshots. checkpoint_save writes the statistics,
+ * touched memory pages, architectural and pipeline state, predictor
+ * and every cache; checkpoint_restore reads them back so a run can be
+ * resumed, or fanned out, from the saved cycle.
+ */
+
+#include "checkpoint.h"
+#include "shell.h"
+#include "pipe.h"
+#include "bp.h"
+#include "cache.h"
+#include "fastfwd.h"
+#include "mem.h"
+#include "prefetch.h"
+#include "storebuf.h"
+#include "ftq.h"
+#include "ooo.h"
+#include "fu.h"
+
+int ckpt_write(FILE* f, const void* p, size_t n) {
+    return fwrite(p, 1, n, f) == n ? 0 : -1;
+}
+
+int ckpt_read(FILE* f, void* p, size_t n) {
+    return fread(p, 1, n, f) == n ? 0 : -1;
+}
+
+static int stats_save(FILE* f) {
+    int err = 0;
+    err |= ckpt_write(f, &stat_cycles, sizeof(stat_cycles));
+    err |= ckpt_write(f, &stat_inst_retire, sizeof(stat_inst_retire));
+    err |= ckpt_write(f, &stat_inst_fetch, sizeof(stat_inst_fetch));
+    err |= ckpt_write(f, &stat_squash, sizeof(stat_squash));
+    err |= ckpt_write(f, &stat_inst_ff, sizeof(stat_inst_ff));
+    return err;
+}
+
+static int stats_load(FILE* f) {
+    int err = 0;
+    err |= ckpt_read(f, &stat_cycles, sizeof(stat_cycles));
+    err |= ckpt_read(f, &stat_inst_retire, sizeof(stat_inst_retire));
+    err |= ckpt_read(f, &stat_inst_fetch, sizeof(stat_inst_fetch));
+    err |= ckpt_read(f, &stat_squash, sizeof(stat_squash));
+    err |= ckpt_read(f, &stat_inst_ff, sizeof(stat_inst_ff));
+    return err;
+}
+
+int checkpoint_save(const char* filename) {
+    FILE* f = fopen(filename, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    ckpt_header hdr = { CKPT_MAGIC, CKPT_VERSION, sizeof(instruction), 0 };
+    int err = ckpt_write(f, &hdr, sizeof(hdr));
+    err |= stats_save(f);
+    err |= mem_save(f);
+    err |= pipe_save(f);
+    err |= bp_save(f);
+    err |= cache_save(f, iCache);
+    err |= cache_save(f, dCache);
+    err |= cache_save(f, l2Cache);
+    err |= prefetch_save(f, iPrefetch);
+    err |= prefetch_save(f, dPrefetch);
+    err |= sb_save(f);
+    err |= ftq_save(f);
+    err |= ooo_save(f);
+    err |= fu_save(f);
+    if (fclose(f) != 0) {
+        err = -1;
+    }
+    return err;
+}
+
+// A file that fails the header check leaves the simulator untouched;
+// one that is truncated past it leaves a partially restored state.
+int checkpoint_restore(const char* filename) {
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    ckpt_header hdr;
+    if (ckpt_read(f, &hdr, sizeof(hdr)) < 0 || hdr.magic != CKPT_MAGIC ||
+            hdr.version != CKPT_VERSION || hdr.inst_size != sizeof(instruction)) {
+        fclose(f);
+        return -1;
+    }
+    int err = stats_load(f);
+    err |= mem_load(f);
+    err |= pipe_load(f);
+    err |= bp_load(f);
+    if (!err) {
+        iCache = cache_load(f, iCache, &err);
+    }
+    if (!err) {
+        dCache = cache_load(f, dCache, &err);
+    }
+    if (!err) {
+        l2Cache = cache_load(f, l2Cache, &err);
+    }
+    if (!err) {
+        iPrefetch = prefetch_load(f, iPrefetch, &err);
+    }
+    if (!err) {
+        dPrefetch = prefetch_load(f, dPrefetch, &err);
+    }
+    if (!err) {
+        err |= sb_load(f);
+    }
+    if (!err) {
+        err |= ftq_load(f);
+    }
+    if (!err) {
+        err |= ooo_load(f);
+    }
+    if (!err) {
+        err |= fu_load(f);
+    }
+    if (iCache != NULL) {
+        iCache->next = l2Cache;
+    }
+    dCache->next = l2Cache;
+    fclose(f);
+    predecode_flush();
+    return err;
+}
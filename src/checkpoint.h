@@ -0,0 +1,36 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Checkpoint file: a header followed by one section per module, in the
+// order stats, memory, cpu/pipeline, branch predictor, iCache, dCache,
+// L2, iCache and dCache prefetchers, store buffer, fetch target queue,
+// out-of-order core, functional units.
+// Each module serializes itself through its *_save / *_load hook.
+#define CKPT_MAGIC   0x504b4341 // "ACKP"
+#define CKPT_VERSION 14
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t inst_size; // sizeof(instruction); latches are stored raw
+    uint32_t reserved;
+} ckpt_header;
+
+int checkpoint_save(const char* filename);
+int checkpoint_restore(const char* filename);
+
+/* return 0 on success, -1 on a short read / write */
+int ckpt_write(FILE* f, const void* p, size_t n);
+int ckpt_read(FILE* f, void* p, size_t n);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "config.h"
+#include "repl.h"
+#include "prefetch.h"
+#include "bp.h"
+#include "ftq.h"
+#include "ooo.h"
+#include "fu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+sim_config config = {
+    .l1i = { .sets = 64, .ways = 4, .block = 32, .latency = 0, .repl = REPL_LRU,
+             .prefetch = PF_NONE, .pf_degree = 1 },
+    .l1d = { .sets = 256, .ways = 8, .block = 32, .latency = 0, .repl = REPL_LRU,
+             .prefetch = PF_NONE, .pf_degree = 1 },
+    .l2 = { .sets = 512, .ways = 8, .block = 64, .latency = 6, .repl = REPL_LRU },
+    .l2_enable = 0,
+    .mem_latency = 10,
+    .mshrs = 0,
+    .sb_entries = 0,
+    .bp_kind = BP_GSHARE,
+    .bp_hist = 8,
+    .bp_bits = 8,
+    .btb_sets = 1024,
+    .btb_ways = 1,
+    .btb_tag_bits = 16,
+    .ras_entries = 8,
+    .ftq_entries = 0,
+    .width = 1,
+    .core = CORE_INORDER,
+    .ooo_rob = 64,
+    .ooo_iq = 32,
+    .ooo_lsq = 32,
+    .ooo_prf = 128,
+    .alu = { .latency = 1, .interval = 1, .count = MAX_WIDTH },
+    .mul = { .latency = 1, .interval = 1, .count = MAX_WIDTH },
+};
+
+// One entry per option. Options with `names` take one of those words
+// and store its index; the rest are plain integers.
+typedef struct {
+    const char* key;
+    int* value;
+    const char* const* names;
+    const char* help;
+} config_opt;
+
+static const config_opt options[] = {
+    { "l1i.sets",    &config.l1i.sets,    NULL, "iCache sets" },
+    { "l1i.ways",    &config.l1i.ways,    NULL, "iCache associativity" },
+    { "l1i.block",   &config.l1i.block,   NULL, "iCache line size (bytes)" },
+    { "l1i.latency", &config.l1i.latency, NULL, "iCache extra hit cycles" },
+    { "l1i.repl",    &config.l1i.repl,    repl_names, "iCache replacement policy" },
+    { "l1i.prefetch", &config.l1i.prefetch, pf_names, "iCache prefetcher" },
+    { "l1i.pf_degree", &config.l1i.pf_degree, NULL, "iCache lines per prefetch trigger" },
+    { "l1d.sets",    &config.l1d.sets,    NULL, "dCache sets" },
+    { "l1d.ways",    &config.l1d.ways,    NULL, "dCache associativity" },
+    { "l1d.block",   &config.l1d.block,   NULL, "dCache line size (bytes)" },
+    { "l1d.latency", &config.l1d.latency, NULL, "dCache extra hit cycles" },
+    { "l1d.repl",    &config.l1d.repl,    repl_names, "dCache replacement policy" },
+    { "l1d.prefetch", &config.l1d.prefetch, pf_names, "dCache prefetcher" },
+    { "l1d.pf_degree", &config.l1d.pf_degree, NULL, "dCache lines per prefetch trigger" },
+    { "l2.enable",   &config.l2_enable,   NULL, "unified L2 behind both L1s (0/1)" },
+    { "l2.sets",     &config.l2.sets,     NULL, "L2 sets" },
+    { "l2.ways",     &config.l2.ways,     NULL, "L2 associativity" },
+    { "l2.block",    &config.l2.block,    NULL, "L2 line size (bytes)" },
+    { "l2.latency",  &config.l2.latency,  NULL, "L2 hit cycles" },
+    { "l2.repl",     &config.l2.repl,     repl_names, "L2 replacement policy" },
+    { "mem.latency", &config.mem_latency, NULL, "main memory cycles" },
+    { "mshr.count",  &config.mshrs,       NULL, "outstanding dCache misses (0 = blocking)" },
+    { "sb.entries",  &config.sb_entries,  NULL, "store buffer entries (0 = none)" },
+    { "bp.predictor", &config.bp_kind,    bp_dir_names, "branch direction predictor" },
+    { "bp.hist",     &config.bp_hist,     NULL, "global history bits" },
+    { "bp.bits",     &config.bp_bits,     NULL, "log2 direction table entries" },
+    { "btb.sets",    &config.btb_sets,    NULL, "BTB sets (power of two)" },
+    { "btb.ways",    &config.btb_ways,    NULL, "BTB associativity" },
+    { "btb.tag_bits", &config.btb_tag_bits, NULL, "BTB partial tag bits" },
+    { "ras.entries", &config.ras_entries, NULL, "return address stack entries (0 = none)" },
+    { "ftq.entries", &config.ftq_entries, NULL, "fetch target queue entries (0 = none)" },
+    { "pipe.width",  &config.width,       NULL, "instructions fetched, issued and retired per cycle" },
+    { "core.model",  &config.core,        core_names, "pipeline model" },
+    { "ooo.rob",     &config.ooo_rob,     NULL, "reorder buffer entries" },
+    { "ooo.iq",      &config.ooo_iq,      NULL, "issue queue entries" },
+    { "ooo.lsq",     &config.ooo_lsq,     NULL, "load-store queue entries" },
+    { "ooo.prf",     &config.ooo_prf,     NULL, "physical registers" },
+    { "alu.latency", &config.alu.latency, NULL, "ALU result cycles" },
+    { "alu.interval", &config.alu.interval, NULL, "cycles between issues to one ALU" },
+    { "alu.count",   &config.alu.count,   NULL, "ALUs" },
+    { "mul.latency", &config.mul.latency, NULL, "multiplier result cycles" },
+    { "mul.interval", &config.mul.interval, NULL, "cycles between issues to one multiplier" },
+    { "mul.count",   &config.mul.count,   NULL, "multipliers" },
+};
+#define NUM_OPTIONS (sizeof(options) / sizeof(options[0]))
+
+int config_set(const char* key, const char* value) {
+    for (int i = 0; i < NUM_OPTIONS; i++) {
+        if (strcmp(options[i].key, key) != 0) {
+            continue;
+        }
+        if (options[i].names != NULL) {
+            for (int j = 0; options[i].names[j] != NULL; j++) {
+                if (strcmp(options[i].names[j], value) == 0) {
+                    *options[i].value = j;
+                    return 0;
+                }
+            }
+            return -1;
+        }
+        char* end;
+        long v = strtol(value, &end, 0);
+        if (end == value || *end != '\0' || v < 0 || v > 0x7fffffff) {
+            return -1;
+        }
+        *options[i].value = v;
+        return 0;
+    }
+    return -1;
+}
+
+int config_set_pair(const char* pair) {
+    char key[64];
+    const char* eq = strchr(pair, '=');
+    if (eq == NULL || eq - pair >= sizeof(key)) {
+        return -1;
+    }
+    memcpy(key, pair, eq - pair);
+    key[eq - pair] = '\0';
+    return config_set(key, eq + 1);
+}
+
+int config_load(const char* filename) {
+    FILE* f = fopen(filename, "r");
+    char line[256], key[64], value[64];
+    int lineno = 0;
+    if (f == NULL) {
+        printf("Error: Can't open config file %s\n", filename);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        char* hash = strchr(line, '#');
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+        int n = sscanf(line, " %63[^= \t] = %63s", key, value);
+        if (n == EOF) {
+            continue; // blank or comment-only line
+        }
+        if (n != 2 || config_set(key, value) < 0) {
+            printf("Error: %s:%d: bad option\n", filename, lineno);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static int pow2(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+static int cache_cfg_ok(const char* name, const cache_cfg* c) {
+    if (!pow2(c->sets) || !pow2(c->block) || c->block < 8 ||
+            c->ways < 1 || c->ways > REPL_MAX_WAYS) {
+        printf("Error: %s needs power-of-two sets and block >= 8, 1 to %d ways\n",
+               name, REPL_MAX_WAYS);
+        return 0;
+    }
+    if (c->repl == REPL_PLRU && !pow2(c->ways)) {
+        printf("Error: %s plru needs power-of-two ways\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+static int fu_cfg_ok(const char* name, const fu_cfg* c) {
+    if (c->latency < 1 || c->latency > FU_MAX_LATENCY || c->interval < 1 ||
+            c->interval > FU_MAX_LATENCY || c->count < 1 || c->count > MAX_WIDTH) {
+        printf("Error: %s.latency and %s.interval must be 1 to %d and %s.count 1 to %d\n",
+               name, name, FU_MAX_LATENCY, name, MAX_WIDTH);
+        return 0;
+    }
+    return 1;
+}
+
+int config_validate() {
+    if (!cache_cfg_ok("l1i", &config.l1i) || !cache_cfg_ok("l1d", &config.l1d) ||
+            (config.l2_enable && !cache_cfg_ok("l2", &config.l2))) {
+        return -1;
+    }
+    if (config.l1i.pf_degree < 1 || config.l1i.pf_degree > PF_MAX_DEGREE ||
+            config.l1d.pf_degree < 1 || config.l1d.pf_degree > PF_MAX_DEGREE) {
+        printf("Error: pf_degree must be 1 to %d\n", PF_MAX_DEGREE);
+        return -1;
+    }
+    if (config.mshrs > MAX_MSHRS) {
+        printf("Error: mshr.count must be 0 to %d\n", MAX_MSHRS);
+        return -1;
+    }
+    if (config.bp_hist > BP_MAX_HIST || config.bp_bits < BP_MIN_BITS || config.bp_bits > BP_MAX_BITS) {
+        printf("Error: bp.hist must be 0 to %d and bp.bits %d to %d\n",
+               BP_MAX_HIST, BP_MIN_BITS, BP_MAX_BITS);
+        return -1;
+    }
+    if (config.btb_sets < 1 || config.btb_sets > BTB_MAX_SETS ||
+            (config.btb_sets & (config.btb_sets - 1)) != 0 ||
+            config.btb_ways < 1 || config.btb_ways > BTB_MAX_WAYS) {
+        printf("Error: btb.sets must be a power of two up to %d and btb.ways 1 to %d\n",
+               BTB_MAX_SETS, BTB_MAX_WAYS);
+        return -1;
+    }
+    if (config.btb_tag_bits < 1 || config.btb_tag_bits > BTB_MAX_TAG_BITS) {
+        printf("Error: btb.tag_bits must be 1 to %d\n", BTB_MAX_TAG_BITS);
+        return -1;
+    }
+    if (config.ras_entries < 0 || config.ras_entries > RAS_MAX_ENTRIES) {
+        printf("Error: ras.entries must be 0 to %d\n", RAS_MAX_ENTRIES);
+        return -1;
+    }
+    if (config.ftq_entries < 0 || config.ftq_entries > FTQ_MAX_ENTRIES) {
+        printf("Error: ftq.entries must be 0 to %d\n", FTQ_MAX_ENTRIES);
+        return -1;
+    }
+    if (config.l1d.prefetch == PF_FDP || (config.l1i.prefetch == PF_FDP && config.ftq_entries == 0)) {
+        printf("Error: fdp prefetching is for the iCache and needs ftq.entries\n");
+        return -1;
+    }
+    if (config.width < 1 || config.width > MAX_WIDTH) {
+        printf("Error: pipe.width must be 1 to %d\n", MAX_WIDTH);
+        return -1;
+    }
+    if (config.sb_entries > SB_MAX_ENTRIES) {
+        printf("Error: sb.entries must be 0 to %d\n", SB_MAX_ENTRIES);
+        return -1;
+    }
+    if (config.ooo_rob < 1 || config.ooo_rob > OOO_MAX_ROB || config.ooo_iq < 1 ||
+            config.ooo_iq > OOO_MAX_IQ || config.ooo_lsq < 1 || config.ooo_lsq > OOO_MAX_LSQ) {
+        printf("Error: ooo.rob must be 1 to %d, ooo.iq 1 to %d and ooo.lsq 1 to %d\n",
+               OOO_MAX_ROB, OOO_MAX_IQ, OOO_MAX_LSQ);
+        return -1;
+    }
+    if (config.ooo_prf < OOO_MIN_PRF || config.ooo_prf > OOO_MAX_PRF) {
+        printf("Error: ooo.prf must be %d to %d\n", OOO_MIN_PRF, OOO_MAX_PRF);
+        return -1;
+    }
+    if (!fu_cfg_ok("alu", &config.alu) || !fu_cfg_ok("mul", &config.mul)) {
+        return -1;
+    }
+    return 0;
+}
+
+void config_print() {
+    for (int i = 0; i < NUM_OPTIONS; i++) {
+        if (options[i].names != NULL) {
+            printf("%-16s = %-10s # %s\n", options[i].key,
+                   options[i].names[*options[i].value], options[i].help);
+        } else {
+            printf("%-16s = %-10d # %s\n", options[i].key, *options[i].value, options[i].help);
+        }
+    }
+    printf("\n");
+}
@@ -0,0 +1,77 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Runtime configuration. Every tunable lives in `config` and is named
+ * by a "section.key" string, settable from a config file (-c file) or
+ * the command line (-o key=value) at startup; the 'config' shell
+ * command prints the result. The defaults reproduce the original fixed
+ * machine.
+ */
+
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include <stdbool.h>
+
+typedef struct {
+    int sets;
+    int ways;
+    int block; // line size in bytes
+    int latency; // extra cycles for a hit at this level
+    int repl; // repl_policy
+    int prefetch; // pf_kind; L1s only
+    int pf_degree; // lines fetched per prefetch trigger
+} cache_cfg;
+
+// One functional unit class; see fu.h
+typedef struct {
+    int latency; // cycles from issue until the result can be used
+    int interval; // cycles between issues to one unit; 1 = fully pipelined
+    int count; // units of this class
+} fu_cfg;
+
+typedef struct {
+    cache_cfg l1i, l1d;
+    cache_cfg l2; // unified, behind both L1s
+    int l2_enable;
+    int mem_latency; // cycles for an access that misses every level
+    int mshrs; // dCache miss registers; 0 blocks MEM on every miss
+    int sb_entries; // store buffer size; 0 writes stores from MEM
+    int bp_kind; // bp_dir_kind
+    int bp_hist; // global history bits
+    int bp_bits; // log2 of direction table entries
+    int btb_sets; // power of two
+    int btb_ways;
+    int btb_tag_bits; // partial tag width
+    int ras_entries; // return address stack; 0 predicts returns from the BTB
+    int ftq_entries; // fetch target queue; 0 predicts inside fetch
+    int width; // instructions per pipeline stage per cycle
+    int core; // core_kind
+    int ooo_rob, ooo_iq, ooo_lsq; // out-of-order window sizes
+    int ooo_prf; // physical registers, including those holding committed state
+    fu_cfg alu, mul;
+} sim_config;
+
+#define MAX_MSHRS 32
+#define SB_MAX_ENTRIES 64
+#define MAX_WIDTH 8
+
+extern sim_config config;
+
+/* set one option from its text value; -1 for an unknown key or bad value */
+int config_set(const char* key, const char* value);
+
+/* "key=value" form of config_set, as given to -o */
+int config_set_pair(const char* pair);
+
+/* read "key = value" lines, '#' starts a comment; -1 on the first error */
+int config_load(const char* filename);
+
+/* check cross-option constraints (power-of-two geometry, ...); -1 if bad */
+int config_validate();
+
+void config_print();
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Functional fast-forward. Instructions execute one at a time straight
+ * on CURRENT_STATE, using the predecode cache and op_table handlers
+ * the pipeline uses, with no timing model. The last few instructions
+ * also warm the iCache, dCache and branch predictor, and then the
+ * (empty) timing pipeline resumes from the next PC.
+ */
+
+#include "fastfwd.h"
+#include "pipe.h"
+#include "shell.h"
+#include "cache.h"
+#include "bp.h"
+
+uint32_t stat_inst_ff = 0;
+
+// Execute up to n instructions; the last `warm` of them also train the
+// caches and predictor. Returns the number of instructions executed.
+uint64_t fastforward(uint64_t n, uint64_t warm)
+{
+    uint64_t pc = pipe_squash();
+    uint64_t warm_from = n > warm ? n - warm : 0;
+    uint64_t i;
+    int line;
+
+    for (i = 0; i < n && RUN_BIT; i++) {
+        bool warming = i >= warm_from;
+        instruction inst = blank_inst;
+        uint64_t next = pc + 4;
+
+        if (warming) {
+            cache_update(iCache, pc, &line);
+        }
+        uint32_t word;
+        cache_read(iCache, pc, &word, 4);
+        predecode_apply(predecode_lookup(pc, word), &inst);
+        inst.current_address = pc;
+        if (!inst.valid) {
+            // the pipeline lets undecodable words through as bubbles
+            pc = next;
+            continue;
+        }
+        if (inst.hltInst) {
+            RUN_BIT = 0;
+        }
+
+        inst.FLAG_N = CURRENT_STATE.FLAG_N;
+        inst.FLAG_Z = CURRENT_STATE.FLAG_Z;
+        int taken = op_table[inst.op].exec(&inst);
+
+        if (inst.type == D_TYPE) {
+            if (warming) {
+                cache_update(dCache, inst.effective_address, &line);
+            }
+            mem_data_access(&inst);
+        }
+        if (inst.writeBack == 1) {
+            CURRENT_STATE.REGS[inst.rt] = inst.ALU_out;
+        }
+        if (inst.writeBack == 2) {
+            CURRENT_STATE.REGS[inst.rt] = inst.mem_out;
+        }
+        if (inst.flagged) {
+            CURRENT_STATE.FLAG_Z = inst.FLAG_Z;
+            CURRENT_STATE.FLAG_N = inst.FLAG_N;
+        }
+        if (inst.type == CB_TYPE || inst.type == B_TYPE) {
+            if (warming) {
+                bp_snap now = bp_snapshot();
+                bp_update(inst.branch_address, pc, branch_kind(&inst), taken, &now, true);
+            }
+            if (taken) {
+                next = inst.branch_address;
+            }
+        }
+
+        ++stat_inst_retire;
+        ++stat_inst_ff;
+        pc = next;
+    }
+
+    CURRENT_STATE.PC = pc;
+    return i;
+}
@@ -0,0 +1,17 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#ifndef _FASTFWD_H_
+#define _FASTFWD_H_
+
+#include <stdint.h>
+
+/* instructions executed by fastforward() since startup */
+extern uint32_t stat_inst_ff;
+
+uint64_t fastforward(uint64_t n, uint64_t warm);
+
+#endif
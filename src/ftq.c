@@ -0,0 +1,99 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "ftq.h"
+#include "shell.h"
+#include "cache.h"
+#include "config.h"
+#include "prefetch.h"
+#include "checkpoint.h"
+#include "trace.h"
+
+// Circular queue of config.ftq_entries slots, oldest at head. bpu_pc
+// is where the predictor continues once the queue has room.
+static struct {
+    ftq_entry e[FTQ_MAX_ENTRIES];
+    int head, count;
+    uint64_t bpu_pc;
+} ftq;
+
+uint32_t stat_ftq_empty = 0;
+
+static inline ftq_entry* ftq_at(int i) {
+    return &ftq.e[(ftq.head + i) % config.ftq_entries];
+}
+
+void ftq_reset() {
+    ftq.head = 0;
+    ftq.count = 0;
+}
+
+void ftq_fill(uint64_t fetch_pc, bool redirected) {
+    if (ftq.count > 0 && (redirected || ftq_at(0)->pc != fetch_pc)) {
+        TRACE(TRACE_DETAIL, TRACE_FETCH, "FTQ: dropped %d entries\n", ftq.count);
+        ftq_reset();
+    }
+    if (ftq.count == 0) {
+        ftq.bpu_pc = fetch_pc;
+        stat_ftq_empty++;
+    }
+    // one prediction per slot fetch can take in a cycle
+    for (int i = 0; i < config.width && ftq.count < config.ftq_entries; i++) {
+        ftq_entry* e = ftq_at(ftq.count);
+        e->pc = ftq.bpu_pc;
+        e->hit = false;
+        e->next = bp_predict(e->pc, &e->hit, &e->snap);
+        ftq.bpu_pc = e->next;
+        // Fetch-directed prefetch: anything queued behind the head will be
+        // fetched later, so start its line now
+        if (ftq.count > 0 && iPrefetch != NULL && iPrefetch->kind == PF_FDP) {
+            prefetch_issue(iPrefetch, iCache, e->pc);
+        }
+        ftq.count++;
+    }
+}
+
+int ftq_count() {
+    return ftq.count;
+}
+
+const ftq_entry* ftq_head() {
+    return ftq_at(0);
+}
+
+void ftq_pop() {
+    ftq.head = (ftq.head + 1) % config.ftq_entries;
+    ftq.count--;
+}
+
+// Entries are stored oldest first, so the ring position is not saved.
+int ftq_save(FILE* f) {
+    int err = ckpt_write(f, &ftq.count, sizeof(ftq.count));
+    err |= ckpt_write(f, &ftq.bpu_pc, sizeof(ftq.bpu_pc));
+    for (int i = 0; i < ftq.count; i++) {
+        err |= ckpt_write(f, ftq_at(i), sizeof(ftq_entry));
+    }
+    err |= ckpt_write(f, &stat_ftq_empty, sizeof(stat_ftq_empty));
+    return err;
+}
+
+int ftq_load(FILE* f) {
+    ftq_reset();
+    int err = ckpt_read(f, &ftq.count, sizeof(ftq.count));
+    if (err || ftq.count < 0 || ftq.count > config.ftq_entries) {
+        ftq.count = 0;
+        return -1;
+    }
+    err |= ckpt_read(f, &ftq.bpu_pc, sizeof(ftq.bpu_pc));
+    for (int i = 0; i < ftq.count; i++) {
+        err |= ckpt_read(f, &ftq.e[i], sizeof(ftq_entry));
+    }
+    err |= ckpt_read(f, &stat_ftq_empty, sizeof(stat_ftq_empty));
+    if (err) {
+        ftq_reset();
+    }
+    return err;
+}
@@ -0,0 +1,49 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Fetch target queue. With ftq.entries > 0 the branch predictor no
+ * longer runs inside fetch: it walks ahead of it, pipe.width
+ * predictions per fetch cycle, and queues each PC with what it
+ * predicted. Fetch takes its PCs and predictions from the head. The
+ * predictor keeps going while fetch waits on the iCache, so with
+ * l1i.prefetch = fdp the lines of the queued PCs are prefetched behind
+ * the miss.
+ */
+
+#ifndef _FTQ_H_
+#define _FTQ_H_
+
+#include "bp.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define FTQ_MAX_ENTRIES 64
+
+typedef struct {
+    uint64_t pc;
+    uint64_t next; // predicted PC after this one
+    bool hit; // BTB hit
+    bp_snap snap; // predictor state before this prediction
+} ftq_entry;
+
+/* cycles fetch found the queue empty and predicted at its own PC */
+extern uint32_t stat_ftq_empty;
+
+void ftq_reset();
+
+/* run the predictor for this cycle; the queue is dropped first if
+   fetch has been redirected away from its head */
+void ftq_fill(uint64_t fetch_pc, bool redirected);
+
+/* oldest entry, which ftq_fill guarantees is for the fetch PC */
+const ftq_entry* ftq_head();
+void ftq_pop();
+int ftq_count();
+
+int ftq_save(FILE* f);
+int ftq_load(FILE* f);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "fu.h"
+#include "shell.h"
+#include "config.h"
+#include "checkpoint.h"
+#include <string.h>
+
+// Indexed by fu_kind
+static const fu_cfg* const fu_cfgs[NUM_FU] = {
+    [FU_NONE] = NULL,
+    [FU_ALU]  = &config.alu,
+    [FU_MUL]  = &config.mul,
+};
+
+// Cycle from which each unit takes its next instruction
+static uint64_t fu_busy[NUM_FU][MAX_WIDTH];
+
+uint32_t stat_fu_busy = 0, stat_fu_wait = 0;
+
+void fu_reset() {
+    memset(fu_busy, 0, sizeof(fu_busy));
+}
+
+int fu_units(int kind) {
+    return fu_cfgs[kind] != NULL ? fu_cfgs[kind]->count : MAX_WIDTH;
+}
+
+int fu_latency(int kind) {
+    return fu_cfgs[kind] != NULL ? fu_cfgs[kind]->latency : 1;
+}
+
+int fu_free(int kind) {
+    if (fu_cfgs[kind] == NULL) {
+        return MAX_WIDTH;
+    }
+    int n = 0;
+    for (int u = 0; u < fu_cfgs[kind]->count; u++) {
+        n += fu_busy[kind][u] <= stat_cycles;
+    }
+    return n;
+}
+
+int fu_issue(int kind) {
+    const fu_cfg* c = fu_cfgs[kind];
+    if (c == NULL) {
+        return 1;
+    }
+    for (int u = 0; u < c->count; u++) {
+        if (fu_busy[kind][u] <= stat_cycles) {
+            fu_busy[kind][u] = stat_cycles + c->interval;
+            break;
+        }
+    }
+    return c->latency;
+}
+
+bool fu_modelled() {
+    for (int k = 0; k < NUM_FU; k++) {
+        const fu_cfg* c = fu_cfgs[k];
+        if (c != NULL && (c->latency > 1 || c->interval > 1 || c->count < config.width)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The unit geometry is configuration; only when each unit frees up is
+// state.
+int fu_save(FILE* f) {
+    int err = ckpt_write(f, fu_busy, sizeof(fu_busy));
+    err |= ckpt_write(f, &stat_fu_busy, sizeof(stat_fu_busy));
+    err |= ckpt_write(f, &stat_fu_wait, sizeof(stat_fu_wait));
+    return err;
+}
+
+int fu_load(FILE* f) {
+    int err = ckpt_read(f, fu_busy, sizeof(fu_busy));
+    err |= ckpt_read(f, &stat_fu_busy, sizeof(stat_fu_busy));
+    err |= ckpt_read(f, &stat_fu_wait, sizeof(stat_fu_wait));
+    if (err) {
+        fu_reset();
+    }
+    return err;
+}
@@ -0,0 +1,54 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Functional units. Each opcode names a unit class in op_table; a
+ * class has alu/mul.count units, each taking a new instruction every
+ * .interval cycles and producing its result .latency cycles after
+ * issue. Both cores hold an instruction back while no unit of its
+ * class is free or while a source is still in a unit. Loads, stores
+ * and branches are FU_NONE: the dCache and branch resolution time
+ * them as before. The defaults, one cycle and a unit per issue slot,
+ * never stall.
+ */
+
+#ifndef _FU_H_
+#define _FU_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    FU_NONE, // not modelled
+    FU_ALU,  // add/sub, logic, shifts, MOVZ
+    FU_MUL,
+    NUM_FU
+} fu_kind;
+
+#define FU_MAX_LATENCY 64
+
+/* cycles an instruction waited for a free unit, and for a result
+   still in a unit */
+extern uint32_t stat_fu_busy, stat_fu_wait;
+
+void fu_reset();
+
+/* units, and cycles to a result, of a class */
+int fu_units(int kind);
+int fu_latency(int kind);
+
+/* units of the class that can take an instruction this cycle */
+int fu_free(int kind);
+
+/* claim a free unit; returns the cycles until the result is ready */
+int fu_issue(int kind);
+
+/* true unless every class is the default single-cycle one */
+bool fu_modelled();
+
+int fu_save(FILE* f);
+int fu_load(FILE* f);
+
+#endif
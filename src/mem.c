@@ -0,0 +1,353 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Guest memory. A direct-mapped table of recently used pages (the TLB)
+ * maps a guest page number straight to the host bytes backing it, so
+ * an access that stays inside one page costs a compare and a memcpy.
+ * Untouched pages map read-only to a shared zero page and get their
+ * own storage on the first write. Pages not wholly inside one region
+ * (the first stack page) and accesses that straddle a page take the
+ * slow, byte-at-a-time path.
+ */
+
+#include "mem.h"
+#include "shell.h"
+#include "pipe.h"
+#include "checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the memory fast path assumes a little-endian host"
+#endif
+
+#define MEM_TLB_ENTRIES 256
+
+mem_region_t MEM_REGIONS[MEM_MAX_REGIONS] = {
+    { "text",  0x00400000, 0x00100000 },
+    { "data",  0x10000000, 0x00100000 },
+    { "stack", 0xfffffffc, 0x00100000 },
+};
+int MEM_NREGIONS = 3;
+
+typedef struct {
+    uint64_t vpn;
+    uint8_t *host; // NULL: empty entry
+    int writable; // 0: host is the shared zero page
+} mem_tlb_t;
+
+static mem_tlb_t MEM_TLB[MEM_TLB_ENTRIES];
+static uint8_t zero_page[MEM_PAGE_SIZE];
+
+int mem_set_region(const char *name, uint64_t start, uint64_t size)
+{
+    int i;
+    for (i = 0; i < MEM_NREGIONS; i++) {
+        if (strcmp(MEM_REGIONS[i].name, name) == 0)
+            break;
+    }
+    if (i == MEM_MAX_REGIONS || strlen(name) >= MEM_NAMELEN)
+        return -1;
+    if (i == MEM_NREGIONS)
+        MEM_NREGIONS++;
+    strcpy(MEM_REGIONS[i].name, name);
+    MEM_REGIONS[i].start = start;
+    MEM_REGIONS[i].size = size;
+    return 0;
+}
+
+int init_memory()
+{
+    int i, j;
+    for (i = 0; i < MEM_NREGIONS; i++) {
+        mem_region_t *r = &MEM_REGIONS[i];
+        if (r->size == 0 || r->start + r->size < r->start)
+            return -1;
+        for (j = 0; j < i; j++) {
+            if (r->start < MEM_REGIONS[j].start + MEM_REGIONS[j].size &&
+                    MEM_REGIONS[j].start < r->start + r->size)
+                return -1;
+        }
+        r->first_vpn = r->start >> MEM_PAGE_BITS;
+        r->npages = ((r->start + r->size - 1) >> MEM_PAGE_BITS) - r->first_vpn + 1;
+        r->pages = calloc(r->npages, sizeof(uint8_t *));
+        r->touched = 0;
+        if (r->pages == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+uint64_t mem_pages_touched()
+{
+    uint64_t n = 0;
+    int i;
+    for (i = 0; i < MEM_NREGIONS; i++)
+        n += MEM_REGIONS[i].touched;
+    return n;
+}
+
+static void mem_tlb_flush()
+{
+    memset(MEM_TLB, 0, sizeof(MEM_TLB));
+}
+
+static uint8_t *mem_page_alloc(mem_region_t *r, uint64_t idx)
+{
+    uint64_t vpn = r->first_vpn + idx;
+    mem_tlb_t *e = &MEM_TLB[vpn & (MEM_TLB_ENTRIES - 1)];
+
+    r->pages[idx] = calloc(1, MEM_PAGE_SIZE);
+    if (r->pages[idx] == NULL) {
+        printf("Error: Out of memory for guest page 0x%" PRIx64 "\n", vpn << MEM_PAGE_BITS);
+        exit(-1);
+    }
+    r->touched++;
+    if (e->vpn == vpn)
+        e->host = NULL; // drop a stale zero-page mapping
+    return r->pages[idx];
+}
+
+static mem_region_t *mem_region(uint64_t address)
+{
+    int i;
+    for (i = 0; i < MEM_NREGIONS; i++) {
+        if (address >= MEM_REGIONS[i].start &&
+                address < (MEM_REGIONS[i].start + MEM_REGIONS[i].size))
+            return &MEM_REGIONS[i];
+    }
+    return NULL;
+}
+
+static uint8_t *mem_tlb_fill(mem_tlb_t *e, uint64_t vpn, int write)
+{
+    uint64_t base = vpn << MEM_PAGE_BITS;
+    mem_region_t *r = mem_region(base);
+    uint8_t *page;
+
+    if (r == NULL || base + MEM_PAGE_SIZE > r->start + r->size)
+        return NULL;
+    page = r->pages[vpn - r->first_vpn];
+    if (page == NULL && write)
+        page = mem_page_alloc(r, vpn - r->first_vpn);
+    e->vpn = vpn;
+    e->writable = page != NULL;
+    e->host = page != NULL ? page : zero_page;
+    return e->host;
+}
+
+/* host pointer for bytes [address, address+bytes), or NULL for the slow path */
+static inline uint8_t *mem_fast(uint64_t address, int bytes, int write)
+{
+    uint64_t vpn = address >> MEM_PAGE_BITS;
+    uint32_t offset = address & (MEM_PAGE_SIZE - 1);
+    mem_tlb_t *e = &MEM_TLB[vpn & (MEM_TLB_ENTRIES - 1)];
+
+    if (offset > MEM_PAGE_SIZE - bytes)
+        return NULL;
+    if (e->host == NULL || e->vpn != vpn || (write && !e->writable)) {
+        if (mem_tlb_fill(e, vpn, write) == NULL)
+            return NULL;
+    }
+    return e->host + offset;
+}
+
+/* host byte for address, NULL if unmapped or (for reads) untouched */
+static uint8_t *mem_slow(uint64_t address, int write)
+{
+    mem_region_t *r = mem_region(address);
+    uint64_t idx;
+
+    if (r == NULL)
+        return NULL;
+    idx = (address >> MEM_PAGE_BITS) - r->first_vpn;
+    if (r->pages[idx] == NULL) {
+        if (!write)
+            return NULL;
+        mem_page_alloc(r, idx);
+    }
+    return r->pages[idx] + (address & (MEM_PAGE_SIZE - 1));
+}
+
+static uint64_t mem_slow_read(uint64_t address, int bytes)
+{
+    int k;
+    uint64_t value = 0;
+    for (k = 0; k < bytes; k++) {
+        uint8_t *b = mem_slow(address + k, 0);
+        if (b != NULL)
+            value |= (uint64_t)*b << (8 * k);
+    }
+    return value;
+}
+
+static void mem_slow_write(uint64_t address, uint64_t value, int bytes)
+{
+    int k;
+    for (k = 0; k < bytes; k++) {
+        uint8_t *b = mem_slow(address + k, 1);
+        if (b != NULL)
+            *b = (value >> (8 * k)) & 0xFF;
+    }
+}
+
+static inline void mem_text_written(uint64_t address, int bytes)
+{
+    if (address - MEM_REGIONS[MEM_TEXT].start < MEM_REGIONS[MEM_TEXT].size) {
+        predecode_invalidate(address);
+        if (bytes > 4)
+            predecode_invalidate(address + 4);
+    }
+}
+
+uint32_t mem_read_32(uint64_t address)
+{
+    uint32_t value;
+    uint8_t *host = mem_fast(address, 4, 0);
+    if (host == NULL)
+        return mem_slow_read(address, 4);
+    memcpy(&value, host, 4);
+    return value;
+}
+
+uint64_t mem_read_64(uint64_t address)
+{
+    uint64_t value;
+    uint8_t *host = mem_fast(address, 8, 0);
+    if (host == NULL)
+        return mem_slow_read(address, 8);
+    memcpy(&value, host, 8);
+    return value;
+}
+
+void mem_write_32(uint64_t address, uint32_t value)
+{
+    uint8_t *host = mem_fast(address, 4, 1);
+    if (host == NULL)
+        mem_slow_write(address, value, 4);
+    else
+        memcpy(host, &value, 4);
+    mem_text_written(address, 4);
+}
+
+void mem_write_64(uint64_t address, uint64_t value)
+{
+    uint8_t *host = mem_fast(address, 8, 1);
+    if (host == NULL)
+        mem_slow_write(address, value, 8);
+    else
+        memcpy(host, &value, 8);
+    mem_text_written(address, 8);
+}
+
+// Copy n bytes starting at address, a page at a time; unmapped bytes
+// read as zero. Used for cache line fills.
+void mem_read_block(uint64_t address, void *dst, uint32_t n)
+{
+    uint8_t *out = dst;
+    while (n > 0) {
+        uint32_t chunk = MEM_PAGE_SIZE - (address & (MEM_PAGE_SIZE - 1));
+        uint8_t *host;
+        if (chunk > n)
+            chunk = n;
+        host = mem_fast(address, chunk, 0);
+        if (host != NULL) {
+            memcpy(out, host, chunk);
+        } else {
+            uint32_t k;
+            for (k = 0; k < chunk; k++)
+                out[k] = mem_slow_read(address + k, 1);
+        }
+        address += chunk;
+        out += chunk;
+        n -= chunk;
+    }
+}
+
+// Copy n bytes to address, a page at a time. Returns -1 (after writing
+// whatever is mapped) if part of the range lies outside every region.
+int mem_write_block(uint64_t address, const void *src, uint64_t n)
+{
+    const uint8_t *in = src;
+    int err = 0;
+
+    if (address < MEM_REGIONS[MEM_TEXT].start + MEM_REGIONS[MEM_TEXT].size &&
+            MEM_REGIONS[MEM_TEXT].start < address + n)
+        predecode_flush();
+    while (n > 0) {
+        uint64_t chunk = MEM_PAGE_SIZE - (address & (MEM_PAGE_SIZE - 1));
+        uint8_t *host;
+        if (chunk > n)
+            chunk = n;
+        host = mem_fast(address, chunk, 1);
+        if (host != NULL) {
+            memcpy(host, in, chunk);
+        } else {
+            uint64_t k;
+            for (k = 0; k < chunk; k++) {
+                uint8_t *b = mem_slow(address + k, 1);
+                if (b == NULL)
+                    err = -1;
+                else
+                    *b = in[k];
+            }
+        }
+        address += chunk;
+        in += chunk;
+        n -= chunk;
+    }
+    return err;
+}
+
+int mem_save(FILE *f)
+{
+    int i, err = 0;
+    uint64_t idx;
+    err |= ckpt_write(f, &MEM_NREGIONS, sizeof(MEM_NREGIONS));
+    for (i = 0; i < MEM_NREGIONS; i++) {
+        mem_region_t *r = &MEM_REGIONS[i];
+        err |= ckpt_write(f, &r->start, sizeof(r->start));
+        err |= ckpt_write(f, &r->size, sizeof(r->size));
+        err |= ckpt_write(f, &r->touched, sizeof(r->touched));
+        for (idx = 0; idx < r->npages; idx++) {
+            if (r->pages[idx] == NULL)
+                continue;
+            err |= ckpt_write(f, &idx, sizeof(idx));
+            err |= ckpt_write(f, r->pages[idx], MEM_PAGE_SIZE);
+        }
+    }
+    return err;
+}
+
+int mem_load(FILE *f)
+{
+    int i, nregions;
+    uint64_t start, size, pages, idx;
+
+    if (ckpt_read(f, &nregions, sizeof(nregions)) < 0 || nregions != MEM_NREGIONS)
+        return -1;
+    mem_tlb_flush();
+    for (i = 0; i < MEM_NREGIONS; i++) {
+        mem_region_t *r = &MEM_REGIONS[i];
+        if (ckpt_read(f, &start, sizeof(start)) < 0 ||
+                ckpt_read(f, &size, sizeof(size)) < 0 ||
+                ckpt_read(f, &pages, sizeof(pages)) < 0 ||
+                start != r->start || size != r->size)
+            return -1;
+
+        for (idx = 0; idx < r->npages; idx++) {
+            free(r->pages[idx]);
+            r->pages[idx] = NULL;
+        }
+        r->touched = 0;
+        while (pages--) {
+            if (ckpt_read(f, &idx, sizeof(idx)) < 0 || idx >= r->npages ||
+                    r->pages[idx] != NULL ||
+                    ckpt_read(f, mem_page_alloc(r, idx), MEM_PAGE_SIZE) < 0)
+                return -1;
+        }
+    }
+    return 0;
+}
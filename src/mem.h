@@ -0,0 +1,51 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#ifndef _MEM_H_
+#define _MEM_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Guest memory is a set of regions, each backed sparsely by 4 KB pages
+// that are allocated on first write. Untouched pages read as zero.
+#define MEM_PAGE_BITS    12
+#define MEM_PAGE_SIZE    (1 << MEM_PAGE_BITS)
+#define MEM_MAX_REGIONS  8
+#define MEM_NAMELEN      16
+
+typedef struct {
+    char name[MEM_NAMELEN];
+    uint64_t start, size;
+    uint64_t first_vpn; // guest page number of pages[0]
+    uint64_t npages;
+    uint8_t **pages; // NULL until first write
+    uint64_t touched; // pages allocated so far
+} mem_region_t;
+
+// The first three regions always exist, in this order.
+enum { MEM_TEXT, MEM_DATA, MEM_STACK };
+
+extern mem_region_t MEM_REGIONS[MEM_MAX_REGIONS];
+extern int MEM_NREGIONS;
+
+/* change a region's layout (or add one) before init_memory; -1 if full */
+int mem_set_region(const char *name, uint64_t start, uint64_t size);
+
+/* allocate the page directories; -1 if regions overlap or are empty */
+int init_memory();
+
+/* bulk copy into guest memory, used by the program loader */
+int mem_write_block(uint64_t address, const void *src, uint64_t n);
+
+/* pages allocated across all regions */
+uint64_t mem_pages_touched();
+
+/* checkpoint hooks: only touched pages are written */
+int mem_save(FILE *f);
+int mem_load(FILE *f);
+
+#endif
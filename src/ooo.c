@@ -0,0 +1,543 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "ooo.h"
+#include "shell.h"
+#include "cache.h"
+#include "bp.h"
+#include "config.h"
+#include "prefetch.h"
+#include "storebuf.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include "fu.h"
+#include <string.h>
+
+const char* const core_names[NUM_CORES + 1] = { "inorder", "ooo", NULL };
+
+#define OOO_FLAGS ARM_REGS // the N/Z flags, renamed as one more register
+#define OOO_ARCH_REGS (ARM_REGS + 1)
+#define PREG_ARCH -1 // value is in CURRENT_STATE
+#define PREG_NONE -2 // operand not used
+
+enum { SRC_RN, SRC_RM, SRC_RT, SRC_FLAGS, NUM_SRC };
+
+typedef struct {
+    instruction inst; // executed in place at issue
+    uint64_t done; // cycle the results are ready; UINT64_MAX until issued
+    int16_t src[NUM_SRC]; // physical sources, or PREG_ARCH / PREG_NONE
+    int16_t dst, old_dst; // rt and the mapping it replaced
+    int16_t fdst, old_fdst; // likewise for the flags
+    bool issued;
+    bool taken; // branch outcome, trained on at commit
+} rob_entry;
+
+// The ROB and load-store queue are circular, oldest at head; the LSQ
+// holds the ROB index of each load and store in program order. The
+// issue queue is an unordered list of ROB indices.
+static struct {
+    rob_entry rob[OOO_MAX_ROB];
+    int rob_head, rob_count;
+    int iq[OOO_MAX_IQ];
+    int iq_count;
+    int lsq[OOO_MAX_LSQ];
+    int lsq_head, lsq_count;
+    int16_t map[OOO_ARCH_REGS];
+    int16_t free_list[OOO_MAX_PRF];
+    int free_count;
+    int64_t prf[OOO_MAX_PRF];
+    uint64_t prf_ready[OOO_MAX_PRF]; // cycle the value can be read
+    uint64_t commit_ready; // a store's dCache access holds commit until then
+} core;
+
+uint32_t stat_ooo_rob_full = 0, stat_ooo_iq_full = 0, stat_ooo_lsq_full = 0, stat_ooo_prf_full = 0;
+uint32_t stat_ooo_load_wait = 0, stat_ooo_squash = 0;
+
+static inline rob_entry* rob_at(int i) {
+    return &core.rob[(core.rob_head + i) % config.ooo_rob];
+}
+
+// Position of ROB slot idx from the head; smaller is older
+static inline int rob_age(int idx) {
+    return (idx - core.rob_head + config.ooo_rob) % config.ooo_rob;
+}
+
+static inline rob_entry* lsq_at(int i) {
+    return &core.rob[core.lsq[(core.lsq_head + i) % config.ooo_lsq]];
+}
+
+void ooo_reset() {
+    memset(&core, 0, sizeof(core));
+    for (int r = 0; r < OOO_ARCH_REGS; r++) {
+        core.map[r] = PREG_ARCH;
+    }
+    for (int p = 0; p < config.ooo_prf; p++) {
+        core.free_list[p] = p;
+    }
+    core.free_count = config.ooo_prf;
+}
+
+// Architectural register behind each source its exec_* handler reads.
+// Store data is not a source: it is read from CURRENT_STATE at commit.
+static int src_arch(const instruction* inst, int src) {
+    switch (src) {
+        case SRC_RN:
+            return inst->type == R_TYPE || inst->type == D_TYPE || inst->op == OP_BR ||
+                   (inst->type == I_TYPE && inst->op != OP_MOVZ) ? inst->rn : -1;
+        case SRC_RM:
+            return inst->type == R_TYPE ? inst->rm : -1;
+        case SRC_RT:
+            return inst->op == OP_CBZ || inst->op == OP_CBNZ ? inst->rt : -1;
+        default:
+            return op_reads_flags(inst->op) ? OOO_FLAGS : -1;
+    }
+}
+
+static int64_t src_value(const rob_entry* e, int src) {
+    int16_t p = e->src[src];
+    if (p >= 0) {
+        return core.prf[p];
+    }
+    if (src == SRC_FLAGS) {
+        return CURRENT_STATE.FLAG_N << 1 | CURRENT_STATE.FLAG_Z;
+    }
+    int r = src_arch(&e->inst, src);
+    return r >= 0 ? CURRENT_STATE.REGS[r] : 0;
+}
+
+static bool src_ready(const rob_entry* e) {
+    for (int s = 0; s < NUM_SRC; s++) {
+        if (e->src[s] >= 0 && core.prf_ready[e->src[s]] > stat_cycles) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int16_t preg_alloc() {
+    int16_t p = core.free_list[--core.free_count];
+    core.prf_ready[p] = UINT64_MAX;
+    return p;
+}
+
+static inline void preg_free(int16_t p) {
+    if (p >= 0) {
+        core.free_list[core.free_count++] = p;
+    }
+}
+
+/* dispatch */
+
+// Rename inst into the ROB, issue queue and LSQ. Returns false, and
+// counts the stall, when one of them has no room.
+static bool dispatch_one(const instruction* inst) {
+    bool mem = inst->type == D_TYPE;
+    int need = (inst->writeBack != 0) + op_sets_flags(inst->op);
+    if (core.rob_count == config.ooo_rob) {
+        stat_ooo_rob_full++;
+        return false;
+    }
+    if (!inst->hltInst && core.iq_count == config.ooo_iq) {
+        stat_ooo_iq_full++;
+        return false;
+    }
+    if (mem && core.lsq_count == config.ooo_lsq) {
+        stat_ooo_lsq_full++;
+        return false;
+    }
+    if (core.free_count < need) {
+        stat_ooo_prf_full++;
+        return false;
+    }
+    TRACE(TRACE_STAGE, TRACE_DE, "DISPATCH: %s X%d, ... current_add: 0x%lx\n", op_name(inst), inst->rt, inst->current_address);
+
+    int idx = (core.rob_head + core.rob_count++) % config.ooo_rob;
+    rob_entry* e = &core.rob[idx];
+    e->inst = *inst;
+    e->issued = false;
+    e->done = UINT64_MAX;
+    for (int s = 0; s < NUM_SRC; s++) {
+        int r = src_arch(inst, s);
+        e->src[s] = r >= 0 ? core.map[r] : PREG_NONE;
+    }
+    e->dst = e->old_dst = PREG_NONE;
+    if (inst->writeBack) {
+        e->old_dst = core.map[inst->rt];
+        e->dst = core.map[inst->rt] = preg_alloc();
+    }
+    e->fdst = e->old_fdst = PREG_NONE;
+    if (op_sets_flags(inst->op)) {
+        e->old_fdst = core.map[OOO_FLAGS];
+        e->fdst = core.map[OOO_FLAGS] = preg_alloc();
+    }
+    if (mem) {
+        core.lsq[(core.lsq_head + core.lsq_count++) % config.ooo_lsq] = idx;
+    }
+    if (inst->hltInst) {
+        // nothing to execute; it only has to reach the head
+        e->issued = true;
+        e->done = stat_cycles;
+        pipe->halt = 0;
+    } else {
+        core.iq[core.iq_count++] = idx;
+    }
+    return true;
+}
+
+// Take IFtoDE in order. Whatever does not fit stays at the front of
+// the latch and fetch holds; nothing after a HLT is kept.
+static void dispatch() {
+    int s;
+    for (s = 0; s < config.width; s++) {
+        instruction* inst = &pipe->IFtoDE[s];
+        if (!inst->valid) {
+            continue;
+        }
+        if (!dispatch_one(inst)) {
+            break;
+        }
+        if (inst->hltInst) {
+            s = config.width;
+        }
+    }
+    int n = s;
+    for (s = 0; s < config.width; s++) {
+        pipe->IFtoDE[s] = s + n < config.width ? pipe->IFtoDE[s + n] : blank_inst;
+    }
+    pipe->de_hold = n < config.width;
+}
+
+/* issue */
+
+// Drop everything younger than ROB slot idx, undoing its renames
+static void squash_after(int idx) {
+    int keep = rob_age(idx) + 1;
+    int squashed = core.rob_count - keep;
+    while (core.rob_count > keep) {
+        rob_entry* y = rob_at(core.rob_count - 1);
+        if (y->dst >= 0) {
+            core.map[y->inst.rt] = y->old_dst;
+            preg_free(y->dst);
+        }
+        if (y->fdst >= 0) {
+            core.map[OOO_FLAGS] = y->old_fdst;
+            preg_free(y->fdst);
+        }
+        if (y->inst.type == D_TYPE) {
+            core.lsq_count--;
+        }
+        if (y->inst.hltInst) {
+            pipe->halt = -1;
+        }
+        core.rob_count--;
+    }
+    int n = 0;
+    for (int i = 0; i < core.iq_count; i++) {
+        if (rob_age(core.iq[i]) < keep) {
+            core.iq[n++] = core.iq[i];
+        }
+    }
+    core.iq_count = n;
+    stat_ooo_squash += squashed;
+    TRACE(TRACE_DETAIL, TRACE_BRANCH, "squashed %d\n", squashed);
+}
+
+// Restart fetch at target behind ROB slot idx
+static void redirect(int idx, uint64_t target) {
+    squash_after(idx);
+    for (int s = 0; s < config.width; s++) {
+        pipe->IFtoDE[s] = blank_inst;
+    }
+    pipe->de_hold = false;
+    pipe->flush = 1;
+    CURRENT_STATE.PC = target;
+    fetch_cancel_miss(target);
+    BTRACE(TREC_BR_MISPRED);
+}
+
+// A load may go once every older store has its address and none of
+// them overlaps it; an overlapping store has to commit first.
+static bool load_may_issue(const rob_entry* e) {
+    uint64_t addr = e->inst.offset + src_value(e, SRC_RN);
+    uint64_t n = e->inst.loadBytes == 1 ? 8 : 4;
+    int age = rob_age(e - core.rob);
+    for (int i = 0; i < core.lsq_count; i++) {
+        const rob_entry* s = lsq_at(i);
+        if (rob_age(s - core.rob) >= age) {
+            break;
+        }
+        if (!s->inst.memWrite) {
+            continue;
+        }
+        if (!s->issued) {
+            return false;
+        }
+        if (s->inst.effective_address < addr + n && addr < s->inst.effective_address + 4) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run ROB slot idx on its renamed operands and publish its results
+static void execute(int idx) {
+    rob_entry* e = &core.rob[idx];
+    instruction* inst = &e->inst;
+    TRACE(TRACE_STAGE, TRACE_EX, "ISSUE: %s, rt: %d, rn: %d, rm: %d\n", op_name(inst), inst->rt, inst->rn, inst->rm);
+    inst->rnVal = src_value(e, SRC_RN);
+    inst->rmVal = src_value(e, SRC_RM);
+    inst->rtVal = src_value(e, SRC_RT);
+    inst->forwarded = FWD_RN | FWD_RM | FWD_RT;
+    if (e->src[SRC_FLAGS] != PREG_NONE) {
+        int64_t flags = src_value(e, SRC_FLAGS);
+        inst->FLAG_N = flags >> 1 & 1;
+        inst->FLAG_Z = flags & 1;
+    }
+    int taken = op_table[inst->op].exec(inst);
+    e->issued = true;
+    e->done = stat_cycles + fu_issue(op_table[inst->op].fu);
+
+    if (inst->memRead) {
+        // address in this cycle, the dCache in the next
+        int line;
+        int hit = cache_update(dCache, inst->effective_address, &line);
+        if (dPrefetch != NULL) {
+            prefetch_access(dPrefetch, dCache, inst->current_address, inst->effective_address, hit);
+        }
+        BTRACE(hit ? TREC_DCACHE_HIT : TREC_DCACHE_MISS);
+        mem_data_access(inst);
+        e->done += 1 + dCache->last_latency;
+    }
+    if (e->dst >= 0) {
+        core.prf[e->dst] = inst->writeBack == 2 ? inst->mem_out : inst->ALU_out;
+        core.prf_ready[e->dst] = e->done;
+    }
+    if (e->fdst >= 0) {
+        core.prf[e->fdst] = inst->FLAG_N << 1 | inst->FLAG_Z;
+        core.prf_ready[e->fdst] = e->done;
+    }
+
+    if (inst->type == CB_TYPE || inst->type == B_TYPE) {
+        e->taken = taken;
+        if (taken) {
+            BTRACE(TREC_BR_TAKEN);
+        }
+        bool predicted_taken = inst->next_address != inst->current_address + 4;
+        bool wrong = taken ? !inst->hit || inst->branch_address != inst->next_address
+                           : inst->hit && predicted_taken;
+        if (wrong) {
+            bp_repair(inst->current_address, branch_kind(inst), taken, &inst->bp_state);
+            redirect(idx, taken ? inst->branch_address : inst->current_address + 4);
+        }
+    } else if (inst->next_address != inst->current_address + 4) {
+        // A partial BTB tag can match a PC that holds no branch
+        bp_restore(&inst->bp_state);
+        redirect(idx, inst->current_address + 4);
+    }
+}
+
+// Select up to pipe.width ready instructions, oldest first, with at
+// most one load for the single dCache port and a free functional unit
+// for each
+static void issue() {
+    bool port_busy = false;
+    bool load_held = false;
+    bool unit_busy = false;
+    for (int picked = 0; picked < config.width; picked++) {
+        int best = -1;
+        for (int i = 0; i < core.iq_count; i++) {
+            rob_entry* e = &core.rob[core.iq[i]];
+            if (best >= 0 && rob_age(core.iq[i]) > rob_age(core.iq[best])) {
+                continue;
+            }
+            if (!src_ready(e)) {
+                continue;
+            }
+            if (fu_free(op_table[e->inst.op].fu) == 0) {
+                unit_busy = true;
+                continue;
+            }
+            if (e->inst.memRead && (port_busy || !load_may_issue(e))) {
+                load_held |= !port_busy;
+                continue;
+            }
+            best = i;
+        }
+        if (best < 0) {
+            break;
+        }
+        int idx = core.iq[best];
+        core.iq[best] = core.iq[--core.iq_count];
+        port_busy |= core.rob[idx].inst.memRead;
+        execute(idx);
+    }
+    if (load_held) {
+        stat_ooo_load_wait++;
+    }
+    if (unit_busy) {
+        stat_fu_busy++;
+    }
+}
+
+/* commit */
+
+// Stores write at commit, into the store buffer if there is one and
+// otherwise straight into the dCache, holding commit for the access.
+// Returns false if the store buffer is full.
+static bool commit_store(instruction* inst) {
+    if (config.sb_entries > 0) {
+        uint32_t word;
+        if (sb_full()) {
+            stat_sb_full++;
+            return false;
+        }
+        if (store_word(inst, &word)) {
+            sb_push(inst->current_address, inst->effective_address, &word, 4);
+        }
+        return true;
+    }
+    int line;
+    int hit = cache_update(dCache, inst->effective_address, &line);
+    if (dPrefetch != NULL) {
+        prefetch_access(dPrefetch, dCache, inst->current_address, inst->effective_address, hit);
+    }
+    BTRACE(hit ? TREC_DCACHE_HIT : TREC_DCACHE_MISS);
+    mem_data_access(inst);
+    core.commit_ready = stat_cycles + dCache->last_latency;
+    return true;
+}
+
+// Branch statistics and predictor training, as EX does in the pipe
+static void commit_branch(const rob_entry* e) {
+    const instruction* inst = &e->inst;
+    int kind = branch_kind(inst);
+    bool predicted_taken = inst->next_address != inst->current_address + 4;
+    bp_update(inst->branch_address, inst->current_address, kind, e->taken, &inst->bp_state, false);
+    if (kind == BTB_COND) {
+        stat_br_cond++;
+        if (predicted_taken != e->taken) {
+            stat_br_dir_miss++;
+        }
+    } else if (kind == BTB_RETURN) {
+        stat_br_ret++;
+        if (inst->next_address != inst->branch_address) {
+            stat_br_ret_miss++;
+        }
+    }
+}
+
+static void commit() {
+    for (int n = 0; n < config.width && core.rob_count > 0; n++) {
+        rob_entry* e = rob_at(0);
+        instruction* inst = &e->inst;
+        if (e->done > stat_cycles || core.commit_ready > stat_cycles) {
+            return;
+        }
+        if (inst->memWrite && !commit_store(inst)) {
+            return;
+        }
+        TRACE(TRACE_STAGE, TRACE_WB, "COMMIT: %s X%d, ... current_add: 0x%lx\n", op_name(inst), inst->rt, inst->current_address);
+        if (e->dst >= 0) {
+            CURRENT_STATE.REGS[inst->rt] = core.prf[e->dst];
+            preg_free(e->old_dst);
+        }
+        if (e->fdst >= 0) {
+            CURRENT_STATE.FLAG_N = core.prf[e->fdst] >> 1 & 1;
+            CURRENT_STATE.FLAG_Z = core.prf[e->fdst] & 1;
+            preg_free(e->old_fdst);
+        }
+        if (inst->type == CB_TYPE || inst->type == B_TYPE) {
+            commit_branch(e);
+        }
+        if (inst->type == D_TYPE) {
+            core.lsq_head = (core.lsq_head + 1) % config.ooo_lsq;
+            core.lsq_count--;
+        }
+        core.rob_head = (core.rob_head + 1) % config.ooo_rob;
+        core.rob_count--;
+        ++stat_inst_retire;
+        BTRACE(TREC_RETIRE);
+
+        if (inst->hltInst) {
+            BTRACE(TREC_HALT);
+            sb_flush();
+            cache_destroy(iCache);
+            iCache = NULL;
+            RUN_BIT = 0;
+            return;
+        }
+    }
+}
+
+// Stages run back to front, as in pipe_cycle, so each sees the state
+// the previous cycle left behind.
+void ooo_cycle() {
+    btrace_begin_cycle();
+    TRACE(TRACE_STAGE, TRACE_CYCLE, "cycle %d\n\n", stat_cycles);
+    if (config.sb_entries > 0) {
+        sb_drain();
+    }
+    commit();
+    if (RUN_BIT) {
+        issue();
+        if (pipe->halt < 0) {
+            dispatch();
+            if (!pipe->de_hold) {
+                pipe_stage_fetch();
+            }
+        }
+    }
+    btrace_end_cycle();
+}
+
+bool ooo_squash(uint64_t* pc) {
+    bool found = core.rob_count > 0;
+    if (found) {
+        *pc = rob_at(0)->inst.current_address;
+    }
+    ooo_reset();
+    return found;
+}
+
+// The core holds no pointers, so it is stored raw behind its geometry,
+// which a restore adopts.
+int ooo_save(FILE* f) {
+    int32_t geom[5] = { config.core, config.ooo_rob, config.ooo_iq, config.ooo_lsq, config.ooo_prf };
+    int err = ckpt_write(f, geom, sizeof(geom));
+    err |= ckpt_write(f, &core, sizeof(core));
+    err |= ckpt_write(f, &stat_ooo_rob_full, sizeof(stat_ooo_rob_full));
+    err |= ckpt_write(f, &stat_ooo_iq_full, sizeof(stat_ooo_iq_full));
+    err |= ckpt_write(f, &stat_ooo_lsq_full, sizeof(stat_ooo_lsq_full));
+    err |= ckpt_write(f, &stat_ooo_prf_full, sizeof(stat_ooo_prf_full));
+    err |= ckpt_write(f, &stat_ooo_load_wait, sizeof(stat_ooo_load_wait));
+    err |= ckpt_write(f, &stat_ooo_squash, sizeof(stat_ooo_squash));
+    return err;
+}
+
+int ooo_load(FILE* f) {
+    int32_t geom[5];
+    if (ckpt_read(f, geom, sizeof(geom)) < 0 || geom[0] < 0 || geom[0] >= NUM_CORES ||
+            geom[1] < 1 || geom[1] > OOO_MAX_ROB || geom[2] < 1 || geom[2] > OOO_MAX_IQ ||
+            geom[3] < 1 || geom[3] > OOO_MAX_LSQ || geom[4] < OOO_MIN_PRF || geom[4] > OOO_MAX_PRF) {
+        return -1;
+    }
+    config.core = geom[0];
+    config.ooo_rob = geom[1];
+    config.ooo_iq = geom[2];
+    config.ooo_lsq = geom[3];
+    config.ooo_prf = geom[4];
+    int err = ckpt_read(f, &core, sizeof(core));
+    err |= ckpt_read(f, &stat_ooo_rob_full, sizeof(stat_ooo_rob_full));
+    err |= ckpt_read(f, &stat_ooo_iq_full, sizeof(stat_ooo_iq_full));
+    err |= ckpt_read(f, &stat_ooo_lsq_full, sizeof(stat_ooo_lsq_full));
+    err |= ckpt_read(f, &stat_ooo_prf_full, sizeof(stat_ooo_prf_full));
+    err |= ckpt_read(f, &stat_ooo_load_wait, sizeof(stat_ooo_load_wait));
+    err |= ckpt_read(f, &stat_ooo_squash, sizeof(stat_ooo_squash));
+    if (err) {
+        ooo_reset();
+    }
+    return err;
+}
@@ -0,0 +1,72 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Out-of-order core, selected with core.model = ooo in place of the
+ * in-order pipe. It shares the front end: pipe_stage_fetch() fills
+ * IFtoDE with pipe.width predicted instructions a cycle, and the same
+ * predictors, caches and FTQ apply. From there each cycle:
+ *
+ *   dispatch  rename up to pipe.width instructions into the reorder
+ *             buffer, the issue queue and (loads and stores) the
+ *             load-store queue; fetch holds while any of them is full
+ *   issue     wake up and select up to pipe.width ready instructions,
+ *             oldest first, and run their exec_* handlers on renamed
+ *             operands; branches resolve and redirect fetch here
+ *   commit    retire up to pipe.width finished instructions in order,
+ *             writing CURRENT_STATE
+ *
+ * Registers, and the N/Z flags as one more register, are renamed onto
+ * ooo.prf physical registers. A register keeps its last mapping after
+ * the writer commits, so only one not written since the last squash is
+ * read straight from CURRENT_STATE; anything else that changes
+ * CURRENT_STATE squashes first (pipe_squash()). Loads go to
+ * the dCache (one a cycle) once every older store has its address and
+ * none of those overlaps; stores write at commit, through the store
+ * buffer when there is one.
+ */
+
+#ifndef _OOO_H_
+#define _OOO_H_
+
+#include "pipe.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    CORE_INORDER, // the 5-stage pipe in pipe.c
+    CORE_OOO,
+    NUM_CORES
+} core_kind;
+
+extern const char* const core_names[NUM_CORES + 1];
+
+#define OOO_MAX_ROB 256
+#define OOO_MAX_IQ 128
+#define OOO_MAX_LSQ 128
+#define OOO_MAX_PRF 512
+// every architectural register plus the flags can hold one physical
+// register with nothing in flight, so fewer than this could deadlock
+#define OOO_MIN_PRF (ARM_REGS + 8)
+
+/* cycles dispatch stopped on a full ROB, issue queue, load-store queue
+   or free list; loads held back by an older store; instructions
+   squashed by redirects */
+extern uint32_t stat_ooo_rob_full, stat_ooo_iq_full, stat_ooo_lsq_full, stat_ooo_prf_full;
+extern uint32_t stat_ooo_load_wait, stat_ooo_squash;
+
+void ooo_reset();
+
+/* one cycle of the out-of-order core, in place of pipe_cycle() */
+void ooo_cycle();
+
+/* empty the core; returns true and sets *pc to the oldest unretired
+   instruction if there was one */
+bool ooo_squash(uint64_t* pc);
+
+int ooo_save(FILE* f);
+int ooo_load(FILE* f);
+
+#endif
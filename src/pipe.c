@@ -9,6 +9,13 @@
 #include "stdbool.h"
 #include "cache.h"
 #include "bp.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "prefetch.h"
+#include "storebuf.h"
+#include "ftq.h"
+#include "ooo.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -20,231 +27,547 @@ bp_t* bp;
 PIPE* pipe;
 cache_t* iCache;
 cache_t* dCache;
+cache_t* l2Cache;
+int RUN_BIT;
+predecode predecode_cache[PREDECODE_ENTRIES];
 
-GSHARE* make_gshare() {
-    GSHARE* gres = (GSHARE*)malloc(sizeof(GSHARE));
-    gres->GHR = 0;
-    for (int i = 0; i < 256; i++) {
-        gres->PHT[i] = 0;
+bp_t* make_bpt() {
+    bp_t* bres = (bp_t*)calloc(1, sizeof(bp_t));
+    bres->dir = bp_dir_new(config.bp_kind, config.bp_hist, config.bp_bits);
+    btb_init(bres, config.btb_sets, config.btb_ways, config.btb_tag_bits, config.ras_entries);
+    return bres;
+}
+
+int branch_kind(const instruction* inst) {
+    if (op_table[inst->op].conditional) {
+        return BTB_COND;
+    }
+    if (inst->op == OP_BL) {
+        return BTB_CALL;
     }
-    return gres;
+    if (inst->op == OP_BR && inst->rn == 30) {
+        return BTB_RETURN;
+    }
+    return BTB_JUMP;
 }
-BTB* make_btb() {
-    BTB* btb = (BTB*)malloc(sizeof(BTB));
-    btb->valid = 0;
-    btb->conditional = 0;
-    btb->address_tag = 0;
-    btb->btarget = 0;
-    return btb;
+
+bool op_sets_flags(int op) {
+    switch (op) {
+        case OP_ADDS_R: case OP_SUBS_R: case OP_CMP_R: case OP_ANDS:
+        case OP_ADDS_I: case OP_SUBS_I: case OP_CMP_I:
+            return true;
+        default:
+            return false;
+    }
 }
-bp_t* make_bpt() {
-    bp_t* bres = (bp_t*)malloc(sizeof(bp_t));
-    bres->gshare = make_gshare();
-    for (int i = 0; i < 1024; i++) {
-        bres->btb[i] = make_btb();
+
+bool op_reads_flags(int op) {
+    return op >= OP_BEQ && op <= OP_BCOND;
+}
+
+// Fresh latch contents: every bubble and fetched instruction starts here
+const instruction blank_inst = { .op = OP_NONE, .type = NO_TYPE, .rm = 100 };
+
+// Placeholder templates so the stages insert bubbles without allocating
+static const instruction BUBBLE = { .op = OP_BUBBLE, .type = NO_TYPE, .rm = 100 };
+static const instruction CACHE_BUBBLE = { .op = OP_CACHE_BUBBLE, .type = NO_TYPE, .rm = 100 };
+static const instruction FLUSH = { .op = OP_FLUSH, .type = NO_TYPE, .rm = 100 };
+static const instruction DCACHE_STALL = { .op = OP_DCACHE_STALL, .type = NO_TYPE, .rm = 100 };
+static const instruction BRANCHED = { .op = OP_BRANCHED, .type = NO_TYPE, .rm = 100, .valid = true };
+
+// Instructions ever taken from the heap. Latches live inline in PIPE
+// and placeholders are static, so this stays 0.
+uint32_t stat_inst_alloc = 0;
+uint32_t stat_mshr_merge = 0, stat_mshr_full = 0, stat_reg_wait = 0;
+
+// Latches are advanced by plain struct copy. The stages run back to
+// front, so each reads its input before the previous stage overwrites it.
+static inline void pipe_reg_transfer(const instruction* inst1, instruction* inst2) {
+    *inst2 = *inst1;
+}
+
+// Put the same placeholder in every slot of a latch
+static inline void fill_group(instruction* group, const instruction* inst) {
+    for (int s = 0; s < config.width; s++) {
+        group[s] = *inst;
     }
-    return bres;
 }
 
-instruction *make_new_inst() {
-    instruction *res = (instruction*)malloc(sizeof(instruction));
-    res->name = (char*)malloc(8*sizeof(char)); // specific type of instruction (e.g. ADD, ADDS, etc.)
-    res->name = "";
-    res->type = NO_TYPE;
-    res->rt, res->rn, res->rm = 100;
-    res->rnVal, res->rmVal, res->rtVal = 0;
-    res->imm, res->offset, res->shamt = 0;
-    res->BR = 0;
-    res->condBR = 0;
-    res->hw = 0;
-    res->op2 = 0;
-    res->hltInst = false;
-    res->hit = false;
-    res->valid = false;
-
-    res->fetched_instruction = 0;
-    res->next_address, res->branch_address = 0;
-    res->current_address = 0;
-    res->flagged = false;
-    res->forwarded = 0;
-
-    res->effective_address = 0;
-    res->ALU_out, res->mem_out = 0;
-    res->memWrite, res->memRead = false;
-    res->writeBack = 0;
-    res->loadBytes = 0;
-
-    res->FLAG_N, res->FLAG_Z = 0;
-    return res;
-}
-
-void pipe_reg_transfer(instruction* inst1, instruction* inst2) {
-    inst2->name = inst1->name;
-    inst2->type = inst1->type;
-    inst2->rt = inst1->rt;
-    inst2->rtVal = inst1->rtVal;
-    inst2->rn = inst1->rn;
-    inst2->rnVal = inst1->rnVal;
-    inst2->rm = inst1->rm;
-    inst2->rmVal = inst1->rmVal;
-    inst2->imm = inst1->imm;
-    inst2->shamt = inst1->shamt;
-    inst2->BR = inst1->BR;
-    inst2->offset = inst1->offset;
-    inst2->condBR = inst1->condBR;
-    inst2->hw = inst1->hw;
-    inst2->op2 = inst1->op2;
-    inst2->hltInst = inst1->hltInst;
-    inst2->hit = inst1->hit;
-    inst2->valid = inst1->valid;
-
-    inst2->fetched_instruction = inst1->fetched_instruction;
-    inst2->next_address = inst1->next_address;
-    inst2->current_address = inst1->current_address;
-    inst2->branch_address = inst1->branch_address;
-    inst2->flagged = inst1->flagged;
-    inst2->forwarded = inst1->forwarded;
-
-    inst2->effective_address = inst1->effective_address;
-    inst2->ALU_out = inst1->ALU_out;
-    inst2->mem_out = inst1->mem_out;
-    inst2->memWrite = inst1->memWrite;
-    inst2->memRead = inst1->memRead;
-    inst2->writeBack = inst1->writeBack;
-    inst2->loadBytes = inst1->loadBytes;
-
-    inst2->FLAG_N = inst1->FLAG_N;
-    inst2->FLAG_Z = inst1->FLAG_Z;
+// Empty every latch and clear the stall / flush state.
+void pipe_reset(PIPE* p) {
+    for (int i = 0; i < NUM_LATCHES; i++) {
+        for (int s = 0; s < MAX_WIDTH; s++) {
+            p->latch[i][s] = blank_inst;
+        }
+    }
+    p->stall = 0;
+    p->btaken = false;
+    p->halt = -1;
+    p->flush = 0;
+    p->fetch_stall = 0;
+    p->missAddress = 0;
+    p->missPending = false;
+    p->lineNumber = 0;
+    p->memStall = 0;
+    p->de_hold = false;
+    p->fetchReady = UINT64_MAX;
+    p->memReady = false;
+    memset(p->mshr, 0, sizeof(p->mshr));
+    memset(p->regReady, 0, sizeof(p->regReady));
+    memset(p->fuReady, 0, sizeof(p->fuReady));
 }
 
 PIPE* make_new_pipe() {
     PIPE* pres = (PIPE*)malloc(sizeof(PIPE));
-    pres->IFtoDE = make_new_inst();
-    pres->DEtoEX = make_new_inst();
-    pres->EXtoMEM = make_new_inst();
-    pres->MEMtoWB = make_new_inst();
-    pres->stall = 0;
-    pres->btaken = false;
-    pres->halt = -1;
-    pres->flush = 0;
-    pres->fetch_stall = 0;
-    pres->missAddress = 0;
-    pres->missPending = false;
-    pres->lineNumber = 0;
-    pres->memStall = 0;
+    pres->IFtoDE = pres->latch[IF_DE];
+    pres->DEtoEX = pres->latch[DE_EX];
+    pres->EXtoMEM = pres->latch[EX_MEM];
+    pres->MEMtoWB = pres->latch[MEM_WB];
+    pipe_reset(pres);
     return pres;
 }
 
+// Squash everything in flight and return the PC of the oldest
+// instruction that has not retired, so it can be executed again.
+// Branch placeholders older than that point stand for branches that
+// already resolved and only need to retire.
+uint64_t pipe_squash() {
+    instruction* oldest_first[NUM_LATCHES] = { pipe->MEMtoWB, pipe->EXtoMEM, pipe->DEtoEX, pipe->IFtoDE };
+    uint64_t pc = CURRENT_STATE.PC;
+    if (config.core == CORE_OOO && ooo_squash(&pc)) {
+        goto done;
+    }
+    for (int i = 0; i < NUM_LATCHES; i++) {
+        for (int s = 0; s < config.width; s++) {
+            if (oldest_first[i][s].op == OP_BRANCHED) {
+                ++stat_inst_retire;
+            } else if (oldest_first[i][s].valid) {
+                pc = oldest_first[i][s].current_address;
+                goto done;
+            }
+        }
+    }
+done:
+    sb_flush();
+    ftq_reset();
+    fu_reset();
+    pipe_reset(pipe);
+    return pc;
+}
+
 void freePipe(PIPE* p) {
-    free(p->IFtoDE);
-    free(p->DEtoEX);
-    free(p->EXtoMEM);
-    free(p->MEMtoWB);
     free(p);
 }
 
+// Decode word into a blank instruction and keep only the fields decode() sets.
+void predecode_fill(predecode* p, uint64_t pc, uint32_t word) {
+    instruction scratch = blank_inst;
+    decode(word, &scratch);
+
+    p->pc = pc;
+    p->word = word;
+    p->filled = true;
+    p->op = scratch.op;
+    p->type = scratch.type;
+    p->rn = scratch.rn;
+    p->rm = scratch.rm;
+    p->rt = scratch.rt;
+    p->imm = scratch.imm;
+    p->shamt = scratch.shamt;
+    p->offset = scratch.offset;
+    p->writeBack = scratch.writeBack;
+    p->loadBytes = scratch.loadBytes;
+    p->valid = scratch.valid;
+    p->hltInst = scratch.hltInst;
+    p->memRead = scratch.memRead;
+    p->memWrite = scratch.memWrite;
+}
+
+// word is what fetch read for pc; a mismatch means the text changed.
+predecode* predecode_lookup(uint64_t pc, uint32_t word) {
+    predecode* p = &predecode_cache[(pc >> 2) & (PREDECODE_ENTRIES - 1)];
+    if (!p->filled || p->pc != pc || p->word != word) {
+        predecode_fill(p, pc, word);
+    }
+    return p;
+}
+
+// Copy a pre-decoded record into a freshly fetched instruction.
+void predecode_apply(predecode* p, instruction* inst) {
+    inst->fetched_instruction = p->word;
+    if (!p->valid) {
+        return; // decode() leaves unknown words untouched
+    }
+    inst->op = p->op;
+    inst->type = p->type;
+    inst->rn = p->rn;
+    inst->rm = p->rm;
+    inst->rt = p->rt;
+    inst->imm = p->imm;
+    inst->shamt = p->shamt;
+    inst->offset = p->offset;
+    inst->writeBack = p->writeBack;
+    inst->loadBytes = p->loadBytes;
+    inst->valid = p->valid;
+    inst->hltInst = p->hltInst;
+    inst->memRead = p->memRead;
+    inst->memWrite = p->memWrite;
+}
+
+void predecode_invalidate(uint64_t address) {
+    // an unaligned write can touch two instruction words
+    predecode* lo = &predecode_cache[(address >> 2) & (PREDECODE_ENTRIES - 1)];
+    predecode* hi = &predecode_cache[((address + 3) >> 2) & (PREDECODE_ENTRIES - 1)];
+    lo->filled = false;
+    hi->filled = false;
+}
+
+static cache_t* make_cache(const cache_cfg* cfg) {
+    cache_t* c = cache_new(cfg->sets, cfg->ways, cfg->block, cfg->repl);
+    c->latency = cfg->latency;
+    return c;
+}
+
+void predecode_flush() {
+    for (int i = 0; i < PREDECODE_ENTRIES; i++) {
+        predecode_cache[i].filled = false;
+    }
+}
+
+// Latches are stored raw; the checkpoint header pins sizeof(instruction).
+int pipe_save(FILE* f) {
+    int err = 0;
+    err |= ckpt_write(f, &CURRENT_STATE, sizeof(CPU_State));
+    err |= ckpt_write(f, &RUN_BIT, sizeof(RUN_BIT));
+    err |= ckpt_write(f, &config.width, sizeof(config.width));
+    err |= ckpt_write(f, pipe->latch, sizeof(pipe->latch));
+    err |= ckpt_write(f, &pipe->stall, sizeof(pipe->stall));
+    err |= ckpt_write(f, &pipe->halt, sizeof(pipe->halt));
+    err |= ckpt_write(f, &pipe->btaken, sizeof(pipe->btaken));
+    err |= ckpt_write(f, &pipe->flush, sizeof(pipe->flush));
+    err |= ckpt_write(f, &pipe->fetch_stall, sizeof(pipe->fetch_stall));
+    err |= ckpt_write(f, &pipe->missPending, sizeof(pipe->missPending));
+    err |= ckpt_write(f, &pipe->missAddress, sizeof(pipe->missAddress));
+    err |= ckpt_write(f, &pipe->lineNumber, sizeof(pipe->lineNumber));
+    err |= ckpt_write(f, &pipe->memStall, sizeof(pipe->memStall));
+    err |= ckpt_write(f, &pipe->de_hold, sizeof(pipe->de_hold));
+    err |= ckpt_write(f, &pipe->fetchReady, sizeof(pipe->fetchReady));
+    err |= ckpt_write(f, &pipe->memReady, sizeof(pipe->memReady));
+    err |= ckpt_write(f, pipe->mshr, sizeof(pipe->mshr));
+    err |= ckpt_write(f, pipe->regReady, sizeof(pipe->regReady));
+    err |= ckpt_write(f, pipe->fuReady, sizeof(pipe->fuReady));
+    err |= ckpt_write(f, &stat_mshr_merge, sizeof(stat_mshr_merge));
+    err |= ckpt_write(f, &stat_mshr_full, sizeof(stat_mshr_full));
+    err |= ckpt_write(f, &stat_reg_wait, sizeof(stat_reg_wait));
+    return err;
+}
+
+int pipe_load(FILE* f) {
+    int err = 0;
+    int width;
+    err |= ckpt_read(f, &CURRENT_STATE, sizeof(CPU_State));
+    err |= ckpt_read(f, &RUN_BIT, sizeof(RUN_BIT));
+    // the latches are always MAX_WIDTH wide, so the saved width is adopted
+    err |= ckpt_read(f, &width, sizeof(width));
+    if (err || width < 1 || width > MAX_WIDTH) {
+        return -1;
+    }
+    config.width = width;
+    err |= ckpt_read(f, pipe->latch, sizeof(pipe->latch));
+    err |= ckpt_read(f, &pipe->stall, sizeof(pipe->stall));
+    err |= ckpt_read(f, &pipe->halt, sizeof(pipe->halt));
+    err |= ckpt_read(f, &pipe->btaken, sizeof(pipe->btaken));
+    err |= ckpt_read(f, &pipe->flush, sizeof(pipe->flush));
+    err |= ckpt_read(f, &pipe->fetch_stall, sizeof(pipe->fetch_stall));
+    err |= ckpt_read(f, &pipe->missPending, sizeof(pipe->missPending));
+    err |= ckpt_read(f, &pipe->missAddress, sizeof(pipe->missAddress));
+    err |= ckpt_read(f, &pipe->lineNumber, sizeof(pipe->lineNumber));
+    err |= ckpt_read(f, &pipe->memStall, sizeof(pipe->memStall));
+    err |= ckpt_read(f, &pipe->de_hold, sizeof(pipe->de_hold));
+    err |= ckpt_read(f, &pipe->fetchReady, sizeof(pipe->fetchReady));
+    err |= ckpt_read(f, &pipe->memReady, sizeof(pipe->memReady));
+    err |= ckpt_read(f, pipe->mshr, sizeof(pipe->mshr));
+    err |= ckpt_read(f, pipe->regReady, sizeof(pipe->regReady));
+    err |= ckpt_read(f, pipe->fuReady, sizeof(pipe->fuReady));
+    err |= ckpt_read(f, &stat_mshr_merge, sizeof(stat_mshr_merge));
+    err |= ckpt_read(f, &stat_mshr_full, sizeof(stat_mshr_full));
+    err |= ckpt_read(f, &stat_reg_wait, sizeof(stat_reg_wait));
+    return err;
+}
+
 void pipe_init()
 {
     memset(&CURRENT_STATE, 0, sizeof(CPU_State));
     CURRENT_STATE.PC = 0x00400000;
     pipe = make_new_pipe();
     bp = make_bpt();
-    iCache  = cache_new(64, 4, 32);
-    dCache = cache_new(256, 8, 32);
+    iCache = make_cache(&config.l1i);
+    dCache = make_cache(&config.l1d);
+    l2Cache = NULL;
+    if (config.l2_enable) {
+        l2Cache = make_cache(&config.l2);
+    }
+    iCache->next = dCache->next = l2Cache;
+    iPrefetch = prefetch_new(config.l1i.prefetch, config.l1i.pf_degree);
+    dPrefetch = prefetch_new(config.l1d.prefetch, config.l1d.pf_degree);
+    ooo_reset();
+    fu_reset();
 }
 
-void ex_hazard() {
+static inline bool is_cbz(const instruction* inst) {
+    return inst->op == OP_CBZ || inst->op == OP_CBNZ;
+}
 
-    /* 1a. pipe->exEXtoMEM->rt = pipe->DEtoEX->rn 
-       1b. pipe->exEXtoMEM->rt = pipe->DEtoEX->rm 
-       2a. pipe->MEMtoWB->rt = pipe->DEtoEX->rn 
-       2b. pipe->MEMtoWB->rt = pipe->DEtoEX->rm */
+/* 1a. EXtoMEM->rt = DEtoEX->rn
+   1b. EXtoMEM->rt = DEtoEX->rm
+   2a. MEMtoWB->rt = DEtoEX->rn
+   2b. MEMtoWB->rt = DEtoEX->rm
+   Every producer slot is checked against every consumer slot, oldest
+   producer first, so the youngest write of a register wins. */
 
-    // First instruction - Mem to Ex Forward
-    int ForwardA, ForwardB = 0;
-    if (pipe->EXtoMEM->writeBack == 1
-        && (pipe->EXtoMEM->rt != 31)
-        && (pipe->EXtoMEM->rt == pipe->DEtoEX->rn)) {
-            //printf("DEtoEX->rn: %d, EXtoMEM->ALU_out: %ld\n", pipe->DEtoEX->rn, pipe->EXtoMEM->ALU_out);
-            ForwardA = 10;
-            pipe->DEtoEX->rnVal = pipe->EXtoMEM->ALU_out;
-            pipe->DEtoEX->forwarded = 1;
+// Mem to Ex Forward
+static void ex_forward(instruction* d, const instruction* e) {
+    if (e->writeBack == 1
+        && (e->rt != 31)
+        && (e->rt == d->rn)) {
+            d->rnVal = e->ALU_out;
+            d->forwarded |= FWD_RN;
         }
-    if (pipe->EXtoMEM->writeBack
-        && (pipe->EXtoMEM->rt  != 31)
-        && (pipe->EXtoMEM->rt == pipe->DEtoEX->rm)) {
-            //printf("DEtoEX->rm: %d, EXtoMEM->rt: %d, EXtoMEM->ALU_out: %ld\n", pipe->DEtoEX->rm, pipe->EXtoMEM->rt, pipe->EXtoMEM->ALU_out);
-            ForwardB = 10;
-            pipe->DEtoEX->rmVal = pipe->EXtoMEM->ALU_out;
-            pipe->DEtoEX->forwarded = 2;
+    if (e->writeBack
+        && (e->rt != 31)
+        && (e->rt == d->rm)) {
+            d->rmVal = e->ALU_out;
+            d->forwarded |= FWD_RM;
+        }
+    // CBZ / CBNZ test rt
+    if (e->writeBack == 1
+        && (e->rt != 31)
+        && is_cbz(d)
+        && (e->rt == d->rt)) {
+            d->rtVal = e->ALU_out;
+            d->forwarded |= FWD_RT;
         }
 }
 
-void mem_hazard() {
-    // Second Instruction - WB to Ex Forward
-    //printf("MEMtoWB->writeBack: %d, MEMtoWB->rt: %d, EXtoMEM->rt: %d, DEtoEX->rn: %d, DEtoEX->rm: %d\n",
-    //pipe->MEMtoWB->writeBack, pipe->MEMtoWB->rt, pipe->EXtoMEM->rt, pipe->DEtoEX->rn, pipe->DEtoEX->rm);
-    int ForwardA, ForwardB = 0;
-    if (pipe->MEMtoWB->writeBack == 1
-        && (pipe->MEMtoWB->rt != 31)
-        && !(pipe->EXtoMEM->writeBack && (pipe->EXtoMEM->rt != 31)
-            && (pipe->EXtoMEM->rt != pipe->DEtoEX->rn))
-        && (pipe->MEMtoWB->rt == pipe->DEtoEX->rn)) {
-            ForwardA = 01;
-            if (pipe->MEMtoWB->writeBack == 1) {
-                pipe->DEtoEX->rnVal = pipe->MEMtoWB->ALU_out;
-            }
-            if (pipe->MEMtoWB->writeBack == 2) {
-                pipe->DEtoEX->rnVal = pipe->MEMtoWB->mem_out;
-            }
-            pipe->DEtoEX->forwarded = 1;
+void ex_hazard() {
+    for (int e = 0; e < config.width; e++) {
+        for (int d = 0; d < config.width; d++) {
+            ex_forward(&pipe->DEtoEX[d], &pipe->EXtoMEM[e]);
         }
+    }
+}
+
+// Does any EX/MEM slot write a register other than r?
+static bool ex_writes_other(int r) {
+    for (int e = 0; e < config.width; e++) {
+        if (pipe->EXtoMEM[e].writeBack && pipe->EXtoMEM[e].rt != 31 && pipe->EXtoMEM[e].rt != r) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (pipe->MEMtoWB->writeBack
-        && (pipe->MEMtoWB->rt != 31)
-        && !(pipe->EXtoMEM->writeBack && (pipe->EXtoMEM->rt != 31)
-            && (pipe->EXtoMEM->rt != pipe->DEtoEX->rm))
-        && (pipe->MEMtoWB->rt == pipe->DEtoEX->rm)) {
-            ForwardB = 01;
-            if (pipe->MEMtoWB->writeBack == 1) {
-                pipe->DEtoEX->rmVal = pipe->MEMtoWB->ALU_out;
+// WB to Ex Forward
+static void mem_forward(instruction* d, const instruction* m) {
+    if (m->writeBack == 1
+        && (m->rt != 31)
+        && !ex_writes_other(d->rn)
+        && (m->rt == d->rn)) {
+            d->rnVal = m->ALU_out;
+            d->forwarded |= FWD_RN;
+        }
+
+    if (m->writeBack
+        && (m->rt != 31)
+        && !ex_writes_other(d->rm)
+        && (m->rt == d->rm)) {
+            if (m->writeBack == 1) {
+                d->rmVal = m->ALU_out;
             }
-            if (pipe->MEMtoWB->writeBack == 2) {
-                pipe->DEtoEX->rmVal = pipe->MEMtoWB->mem_out;
+            if (m->writeBack == 2) {
+                d->rmVal = m->mem_out;
             }
-            printf("rmVal: %ld\n", pipe->DEtoEX->rmVal);
-            pipe->DEtoEX->forwarded = 2;
+            TRACE(TRACE_DETAIL, TRACE_HAZARD, "rmVal: %ld\n", d->rmVal);
+            d->forwarded |= FWD_RM;
         }
 
     // Load / store forward
-    if ((pipe->MEMtoWB->memRead) && (pipe->DEtoEX->memWrite) &&
-        (pipe->MEMtoWB->rt == pipe->DEtoEX->rt)) {
-            pipe->DEtoEX->rtVal = pipe->MEMtoWB->mem_out;
-            pipe->DEtoEX->forwarded = 3;
-    }
-}
-
-// Goes in Decode.
-void hazard_detection_unit() {
-        // Load Stall
-    //printf("HDU: %s, memRead? %d, DEtoEX->rt: %d, IFtoDE->rn: %d, IFtoDE->rm: %d, IFtoDE->rt: %d\n", pipe->DEtoEX->name, pipe->DEtoEX->memRead, pipe->DEtoEX->rt, pipe->IFtoDE->rn, pipe->IFtoDE->rm, pipe->IFtoDE->rt);
-    if (pipe->DEtoEX->memRead &&
-       ((pipe->DEtoEX->rt == pipe->IFtoDE->rn) ||
-        (pipe->DEtoEX->rt == pipe->IFtoDE->rm))) {
-           printf("     stalled Load1\n");
-           pipe->stall = 1;
-       }
-       //Load Store Stall
-    if (pipe->DEtoEX->memRead && 
-       (pipe->DEtoEX->rt == pipe->IFtoDE->rt) && pipe->IFtoDE->memWrite) {
-           pipe->stall = 1;
-           printf("     stalled Load2\n");
-       }
+    if ((m->memRead) && (d->memWrite) &&
+        (m->rt == d->rt)) {
+            d->rtVal = m->mem_out;
+            d->forwarded |= FWD_RT;
+    }
+
+    if (m->writeBack
+        && (m->rt != 31)
+        && is_cbz(d)
+        && !ex_writes_other(d->rt)
+        && (m->rt == d->rt)) {
+            d->rtVal = m->writeBack == 2 ? m->mem_out : m->ALU_out;
+            d->forwarded |= FWD_RT;
+        }
+}
+
+void mem_hazard() {
+    for (int m = 0; m < config.width; m++) {
+        for (int d = 0; d < config.width; d++) {
+            mem_forward(&pipe->DEtoEX[d], &pipe->MEMtoWB[m]);
+        }
+    }
+}
+
+// Registers inst reads; stores also read rt, in MEM. Returns how many.
+static int src_regs(const instruction* inst, int regs[2]) {
+    switch (inst->type) {
+        case R_TYPE:
+            regs[0] = inst->rn;
+            regs[1] = inst->rm;
+            return 2;
+        case I_TYPE:
+            regs[0] = inst->rn;
+            return inst->op != OP_MOVZ;
+        case D_TYPE:
+            regs[0] = inst->rn;
+            regs[1] = inst->rt;
+            return inst->memWrite ? 2 : 1;
+        case CB_TYPE:
+            regs[0] = inst->rt;
+            return inst->op == OP_CBZ || inst->op == OP_CBNZ;
+        case B_TYPE:
+            regs[0] = inst->rn;
+            return inst->op == OP_BR;
+        default:
+            return 0;
+    }
+}
+
+static bool reads_reg(const instruction* inst, int r) {
+    int regs[2];
+    int n = src_regs(inst, regs);
+    for (int i = 0; i < n; i++) {
+        if (regs[i] == r) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Goes in Decode, over the n slots of IFtoDE that issue this cycle.
+void hazard_detection_unit(int n) {
+    for (int d = 0; d < config.width; d++) {
+        instruction* ex = &pipe->DEtoEX[d];
+        for (int i = 0; i < n; i++) {
+            instruction* de = &pipe->IFtoDE[i];
+            // Load Stall
+            if (ex->memRead &&
+               ((ex->rt == de->rn) ||
+                (ex->rt == de->rm))) {
+                   TRACE(TRACE_DETAIL, TRACE_HAZARD, "     stalled Load1\n");
+                   pipe->stall = 1;
+                   BTRACE(TREC_STALL);
+               }
+               //Load Store Stall
+            if (ex->memRead &&
+               (ex->rt == de->rt) && de->memWrite) {
+                   pipe->stall = 1;
+                   BTRACE(TREC_STALL);
+                   TRACE(TRACE_DETAIL, TRACE_HAZARD, "     stalled Load2\n");
+               }
+            // Load then CBZ / CBNZ on it
+            if (ex->memRead && is_cbz(de) && ex->rt == de->rt) {
+                pipe->stall = 1;
+                BTRACE(TREC_STALL);
+                TRACE(TRACE_DETAIL, TRACE_HAZARD, "     stalled Load3\n");
+            }
+        }
+    }
+}
+
+static inline bool reg_pending(int r) {
+    return r != 31 && pipe->regReady[r] > stat_cycles;
+}
+
+// Does inst read a register whose load is still filling in an MSHR?
+static bool ex_operand_pending(const instruction* inst) {
+    int regs[2];
+    int n = inst->valid ? src_regs(inst, regs) : 0;
+    for (int i = 0; i < n; i++) {
+        if (reg_pending(regs[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ex_group_pending() {
+    for (int s = 0; s < config.width; s++) {
+        if (ex_operand_pending(&pipe->DEtoEX[s])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Structural and RAW hazards on the functional units: does the group
+// need more units of a class than are free, or read a result still in
+// one? Stores read their data a cycle later, in MEM.
+static bool ex_fu_hazard() {
+    int need[NUM_FU] = { 0 };
+    bool raw = false;
+    for (int s = 0; s < config.width; s++) {
+        const instruction* inst = &pipe->DEtoEX[s];
+        if (!inst->valid) {
+            continue;
+        }
+        need[op_table[inst->op].fu]++;
+        int regs[2];
+        int n = src_regs(inst, regs);
+        for (int i = 0; i < n; i++) {
+            uint64_t used = stat_cycles + (inst->memWrite && i == 1);
+            raw |= regs[i] != 31 && pipe->fuReady[regs[i]] > used;
+        }
+        raw |= op_reads_flags(inst->op) && pipe->fuReady[ARM_REGS] > stat_cycles;
+    }
+    for (int k = 0; k < NUM_FU; k++) {
+        if (need[k] > fu_free(k)) {
+            stat_fu_busy++;
+            TRACE(TRACE_DETAIL, TRACE_HAZARD, "     waiting on a functional unit\n");
+            return true;
+        }
+    }
+    if (raw) {
+        stat_fu_wait++;
+        TRACE(TRACE_DETAIL, TRACE_HAZARD, "     waiting on a functional unit result\n");
+    }
+    return raw;
+}
+
+// Hold DEtoEX (and so DE and IF) for a cycle and send bubbles on to
+// MEM; MEM's flag forwarding then takes the flags from CURRENT_STATE.
+// Forwarding is redone from scratch next cycle: anything forwarded so
+// far has reached REGS by the time EX runs.
+static void ex_wait(bool load) {
+    for (int s = 0; s < config.width; s++) {
+        pipe_reg_transfer(&BUBBLE, &pipe->EXtoMEM[s]);
+        pipe->DEtoEX[s].forwarded = 0;
+    }
+    if (pipe->stall > 0) {
+        pipe->stall--;
+    }
+    if (load) {
+        stat_reg_wait++;
+        TRACE(TRACE_DETAIL, TRACE_HAZARD, "     waiting on load\n");
+        BTRACE(TREC_REG_WAIT);
+    }
 }
 
 void pipe_cycle()
 {
-    printf("cycle %d\n\n", stat_cycles);
+    btrace_begin_cycle();
+    TRACE(TRACE_STAGE, TRACE_CYCLE, "cycle %d\n\n", stat_cycles);
+    if (config.sb_entries > 0) {
+        sb_drain();
+    }
     //printf("CURRENT_STATE.PC: 0x%lx\n", CURRENT_STATE.PC);
     pipe_stage_wb();
     if (pipe->memStall == 0) {
@@ -253,20 +576,31 @@ void pipe_cycle()
             pipe->memStall--;
             if (pipe->flush > 0) {
                 pipe->flush--;
-                printf("flushing %d\n", pipe->flush);
+                TRACE(TRACE_DETAIL, TRACE_CYCLE, "flushing %d\n", pipe->flush);
             }
             if (pipe->fetch_stall) {
                 pipe->fetch_stall--;
-                printf("fetch_stalling %d\n", pipe->fetch_stall);
+                TRACE(TRACE_DETAIL, TRACE_CYCLE, "fetch_stalling %d\n", pipe->fetch_stall);
             }
-            printf("mem stalling %d\n", pipe->memStall);
+            TRACE(TRACE_DETAIL, TRACE_CYCLE, "mem stalling %d\n", pipe->memStall);
+            BTRACE(TREC_MEM_STALL);
+            btrace_end_cycle();
+            return;
+        }
+        bool load_wait = config.mshrs > 0 && ex_group_pending();
+        if (load_wait || (pipe->stall == 0 && ex_fu_hazard())) {
+            ex_wait(load_wait);
+            btrace_end_cycle();
             return;
         }
         pipe_stage_execute();
         if (pipe->stall  == 0) {
             if (pipe->halt < 0) {
+                pipe->de_hold = false;
                 pipe_stage_decode();
-                pipe_stage_fetch();
+                if (!pipe->de_hold) {
+                    pipe_stage_fetch();
+                }
             }
         } else {
             pipe->stall--;
@@ -276,231 +610,524 @@ void pipe_cycle()
         pipe->memStall--;
         if (pipe->flush > 0) {
             pipe->flush--;
-            printf("flushing %d\n", pipe->flush);
+            TRACE(TRACE_DETAIL, TRACE_CYCLE, "flushing %d\n", pipe->flush);
         }
         if (pipe->fetch_stall) {
             pipe->fetch_stall--;
-            printf("fetch_stalling %d\n", pipe->fetch_stall);
+            TRACE(TRACE_DETAIL, TRACE_CYCLE, "fetch_stalling %d\n", pipe->fetch_stall);
         }
-        printf("mem stalling %d\n", pipe->memStall);
+        TRACE(TRACE_DETAIL, TRACE_CYCLE, "mem stalling %d\n", pipe->memStall);
+        BTRACE(TREC_MEM_STALL);
     }
-    
+    btrace_end_cycle();
 
 }
 
 void pipe_stage_wb()
 {
-    printf("WB: %s X%d, ..., writeBack: %d\n", pipe->MEMtoWB->name, pipe->MEMtoWB->rt, pipe->MEMtoWB->writeBack);
+    for (int s = 0; s < config.width; s++) {
+        TRACE(TRACE_STAGE, TRACE_WB, "WB: %s X%d, ..., writeBack: %d\n", op_name(&pipe->MEMtoWB[s]), pipe->MEMtoWB[s].rt, pipe->MEMtoWB[s].writeBack);
+    }
 
     mem_hazard();
     if (pipe->memStall > 0) {
         return;
     }
-    if (pipe->MEMtoWB->writeBack == 1) {
-        CURRENT_STATE.REGS[pipe->MEMtoWB->rt] = pipe->MEMtoWB->ALU_out;
-    }
-    if (pipe->MEMtoWB->writeBack == 2) {
-        CURRENT_STATE.REGS[pipe->MEMtoWB->rt] = pipe->MEMtoWB->mem_out;
-    }
-
-    if (pipe->MEMtoWB->flagged) {
-        CURRENT_STATE.FLAG_Z = pipe->MEMtoWB->FLAG_Z;
-        CURRENT_STATE.FLAG_N = pipe->MEMtoWB->FLAG_N;
-    }
+    // Retire the group in program order
+    bool halted = false;
+    for (int s = 0; s < config.width; s++) {
+        instruction* inst = &pipe->MEMtoWB[s];
+        if (inst->writeBack == 1) {
+            CURRENT_STATE.REGS[inst->rt] = inst->ALU_out;
+        }
+        if (inst->writeBack == 2) {
+            CURRENT_STATE.REGS[inst->rt] = inst->mem_out;
+        }
 
-    if (pipe->MEMtoWB->valid) {
-        ++stat_inst_retire;
-    } else {
-        if (!strcmp(pipe->MEMtoWB->name, "flush")) {
-            printf("flushed\n");
+        if (inst->flagged) {
+            CURRENT_STATE.FLAG_Z = inst->FLAG_Z;
+            CURRENT_STATE.FLAG_N = inst->FLAG_N;
         }
-        else if (!strcmp(pipe->MEMtoWB->name, "fetch_stall")) {
-            printf("fetch_stall\n");
+
+        if (inst->valid) {
+            ++stat_inst_retire;
+            BTRACE(TREC_RETIRE);
+            halted |= inst->hltInst;
+        } else {
+            if (inst->op == OP_FLUSH) {
+                TRACE(TRACE_DETAIL, TRACE_WB, "flushed\n");
+            }
         }
     }
-    
-    pipe->halt--;
-
 
-    if (pipe->halt == 0) {
+    if (halted) {
+        BTRACE(TREC_HALT);
+        sb_flush();
         cache_destroy(iCache);
+        iCache = NULL;
         RUN_BIT = 0;
     }
    
 }
 
-void loadWrite_dCache(bool load, bool write, uint64_t address) {
+// Charge the access latency once: the stall re-runs MEM, and that
+// second pass finds the filled line and completes the access without
+// counting as another use for replacement.
+void loadWrite_dCache(bool load, bool write, uint64_t address, uint64_t pc) {
     int line;
-    int hit = cache_update(dCache, address, &line);
-    if (!hit) {
-        printf("dCache miss\n");
-        pipe->memStall = 10;
+    int hit;
+    if (pipe->memReady && cache_probe(dCache, address, &line)) {
+        hit = 1;
+    } else {
+        hit = cache_update(dCache, address, &line);
+        if (dPrefetch != NULL) {
+            prefetch_access(dPrefetch, dCache, pc, address, hit);
+        }
+    }
+    if (dCache->last_latency > 0 && !pipe->memReady) {
+        if (!hit) {
+            TRACE(TRACE_DETAIL, TRACE_CACHE, "dCache miss\n");
+            BTRACE(TREC_DCACHE_MISS);
+        }
+        pipe->memStall = dCache->last_latency;
+        pipe->memReady = true;
         return;
     }
-    printf("dCache Hit\n");
+    pipe->memReady = false;
+    TRACE(TRACE_DETAIL, TRACE_CACHE, "dCache Hit\n");
+    BTRACE(TREC_DCACHE_HIT);
 }
+// Non-blocking dCache access, used when config.mshrs > 0. A primary
+// miss takes a free MSHR and the instruction moves on; a load's
+// destination becomes readable a cycle after the fill returns (see
+// ex_operand_pending). A miss to a line already being filled merges
+// into its MSHR. With every MSHR busy, MEM stalls until the oldest
+// frees. Returns false for a plain hit, which takes the blocking path
+// so any l1d.latency is still charged.
+static bool mshr_access(instruction* inst) {
+    uint64_t address = inst->effective_address;
+    uint64_t block = address & ~(uint64_t)(dCache->block_size - 1);
+    uint64_t oldest = UINT64_MAX;
+    uint64_t ready;
+    int free_i = -1;
+    int match = -1;
+    int line;
+    for (int i = 0; i < config.mshrs; i++) {
+        if (pipe->mshr[i].ready <= stat_cycles) {
+            if (free_i < 0) {
+                free_i = i;
+            }
+            continue;
+        }
+        if (pipe->mshr[i].line == block) {
+            match = i;
+        }
+        if (pipe->mshr[i].ready < oldest) {
+            oldest = pipe->mshr[i].ready;
+        }
+    }
+    if (match >= 0) {
+        cache_update(dCache, address, &line);
+        if (dPrefetch != NULL) {
+            prefetch_access(dPrefetch, dCache, inst->current_address, address, 0);
+        }
+        ready = pipe->mshr[match].ready;
+        stat_mshr_merge++;
+        TRACE(TRACE_DETAIL, TRACE_CACHE, "dCache miss merged\n");
+        BTRACE(TREC_MSHR_MERGE);
+    } else if (cache_probe(dCache, address, &line)) {
+        return false;
+    } else if (free_i < 0) {
+        pipe->memStall = oldest - stat_cycles;
+        stat_mshr_full += pipe->memStall;
+        TRACE(TRACE_DETAIL, TRACE_CACHE, "MSHRs full\n");
+        return true;
+    } else {
+        cache_update(dCache, address, &line);
+        ready = stat_cycles + dCache->last_latency;
+        if (dPrefetch != NULL) {
+            prefetch_access(dPrefetch, dCache, inst->current_address, address, 0);
+        }
+        pipe->mshr[free_i].line = block;
+        pipe->mshr[free_i].ready = ready;
+        TRACE(TRACE_DETAIL, TRACE_CACHE, "dCache miss\n");
+        BTRACE(TREC_DCACHE_MISS);
+    }
+    if (inst->memRead) {
+        pipe->regReady[inst->rt] = ready + 1;
+    }
+    return true;
+}
+
+// The value a store writes: always 4 bytes, from the low bits of rt.
+// Returns false for a D-type that stores nothing.
+bool store_word(const instruction* inst, uint32_t* word) {
+    switch (inst->loadBytes) {
+        case 0:
+            return false;
+        case 1: 
+            *word = CURRENT_STATE.REGS[inst->rt];
+            break;
+        case 2:
+            *word = (int16_t)CURRENT_STATE.REGS[inst->rt];
+            break;
+        case 3:
+            *word = (char)CURRENT_STATE.REGS[inst->rt];
+            break;
+    }
+    return true;
+}
+
+// Loads read through the dCache and then see any newer data still
+// sitting in the store buffer.
+static void load_bytes(uint64_t address, void* buf, int n) {
+    cache_read(dCache, address, buf, n);
+    sb_forward(address, buf, n);
+}
+
+// Perform the memory side of a load or store through the dCache:
+// stores write the register into the line, loads leave the value in
+// mem_out. Lines the dCache does not hold are accessed in memory.
+void mem_data_access(instruction* inst) {
+    uint32_t word;
+    uint64_t dword;
+    if (inst->memWrite == true) {
+        if (!store_word(inst, &word)) {
+            return;
+        }
+        cache_write(dCache, inst->effective_address, &word, 4);
+    }
+    if (inst->memRead == true) {
+        switch (inst->loadBytes) {
+            case 0:
+                return;
+            case 1: 
+                //Reading 64 bits
+                load_bytes(inst->effective_address, &dword, 8);
+                inst->mem_out = dword;
+                break;
+            case 2:
+                load_bytes(inst->effective_address, &word, 4);
+                inst->mem_out = (int16_t)word;
+                break;
+            case 3:
+                load_bytes(inst->effective_address, &word, 4);
+                inst->mem_out = (char)word;
+                break;
+        }
+    }
+}
+
 void pipe_stage_mem()
 {
-    printf("MEM: %s X%d, ...\n", pipe->EXtoMEM->name, pipe->EXtoMEM->rt);
+    instruction* inst = NULL;
+    for (int s = 0; s < config.width; s++) {
+        TRACE(TRACE_STAGE, TRACE_MEM, "MEM: %s X%d, ...\n", op_name(&pipe->EXtoMEM[s]), pipe->EXtoMEM[s].rt);
+        // one dCache port: decode lets at most one access into a group
+        if (pipe->EXtoMEM[s].type == D_TYPE) {
+            inst = &pipe->EXtoMEM[s];
+        }
+    }
     ex_hazard();
 
-    if (pipe->EXtoMEM->type == D_TYPE) {
-        loadWrite_dCache(pipe->EXtoMEM->memRead, pipe->EXtoMEM->memWrite, pipe->EXtoMEM->effective_address);
+    if (inst != NULL) {
+        // With a store buffer a store only needs a free entry; a load
+        // the buffer fully covers needs no dCache access.
+        bool buffered = config.sb_entries > 0 && inst->memWrite;
+        if (buffered) {
+            if (sb_full()) {
+                pipe->memStall = sb_wait();
+                stat_sb_full += pipe->memStall;
+                TRACE(TRACE_DETAIL, TRACE_CACHE, "store buffer full\n");
+            }
+        } else if (config.sb_entries > 0 && inst->memRead &&
+                sb_lookup(inst->effective_address, inst->loadBytes == 1 ? 8 : 4) == SB_ALL) {
+            stat_sb_forwards++;
+            TRACE(TRACE_DETAIL, TRACE_CACHE, "store forwarded\n");
+        } else if (config.mshrs == 0 || !mshr_access(inst)) {
+            loadWrite_dCache(inst->memRead, inst->memWrite, inst->effective_address, inst->current_address);
+        }
         if (pipe->memStall > 0) {
-            instruction* temp = make_new_inst();
-            temp->name = "dCache stall bubble";
-            pipe_reg_transfer(temp, pipe->MEMtoWB);
+            fill_group(pipe->MEMtoWB, &DCACHE_STALL);
             return;
         }
-        if (pipe->EXtoMEM->memWrite == true) {
-            switch (pipe->EXtoMEM->loadBytes) {
-                case 0:
-                    return;
-                case 1: 
-                    mem_write_32(pipe->EXtoMEM->effective_address, CURRENT_STATE.REGS[pipe->EXtoMEM->rt]);
-                    break;
-                case 2:
-                    mem_write_32(pipe->EXtoMEM->effective_address, (int16_t)CURRENT_STATE.REGS[pipe->EXtoMEM->rt]);
-                    break;
-                case 3:
-                    mem_write_32(pipe->EXtoMEM->effective_address, (char)CURRENT_STATE.REGS[pipe->EXtoMEM->rt]);
-                    break;
-            }
+        uint32_t word;
+        if (!buffered) {
+            mem_data_access(inst);
+        } else if (store_word(inst, &word)) {
+            sb_push(inst->current_address, inst->effective_address, &word, 4);
         }
-        if (pipe->EXtoMEM->memRead == true) {
-            switch (pipe->EXtoMEM->loadBytes) {
-                case 0:
-                    return;
-                case 1: 
-                    //Writing 64 bits
-                    pipe->EXtoMEM->mem_out = (((uint64_t)(mem_read_32(pipe->EXtoMEM->effective_address + 4))) << 32) | mem_read_32(pipe->EXtoMEM->effective_address);
-                    break;
-                case 2:
-                    pipe->EXtoMEM->mem_out = (int16_t)mem_read_32(pipe->EXtoMEM->effective_address);
-                    break;
-                case 3:
-                    pipe->EXtoMEM->mem_out = (char)mem_read_32(pipe->EXtoMEM->effective_address);
-                    break;
-            }
+    }
+    // Flag Forwarding: from the youngest instruction ahead, which
+    // carries the flags it saw when it set none; behind bubbles
+    // everything older has already written back
+    pipe->DEtoEX->FLAG_Z = CURRENT_STATE.FLAG_Z;
+    pipe->DEtoEX->FLAG_N = CURRENT_STATE.FLAG_N;
+    for (int s = 0; s < config.width; s++) {
+        if (pipe->EXtoMEM[s].valid) {
+            pipe->DEtoEX->FLAG_Z = pipe->EXtoMEM[s].FLAG_Z;
+            pipe->DEtoEX->FLAG_N = pipe->EXtoMEM[s].FLAG_N;
         }
+        pipe_reg_transfer(&pipe->EXtoMEM[s], &pipe->MEMtoWB[s]);
     }
-    // Flag Forwarding
-    pipe->DEtoEX->FLAG_Z = pipe->EXtoMEM->FLAG_Z;
-    pipe->DEtoEX->FLAG_N = pipe->EXtoMEM->FLAG_N;
-    pipe_reg_transfer(pipe->EXtoMEM, pipe->MEMtoWB);
 
 }
 
-void pipe_stage_execute()
-{
-    printf("EX: %s, memRead? %d, rt: %d, rn: %d, rm: %d\n", pipe->DEtoEX->name, pipe->DEtoEX->memRead, pipe->DEtoEX->rt, pipe->DEtoEX->rn, pipe->DEtoEX->rm);
-    if (!pipe->DEtoEX->valid) {
-        pipe_reg_transfer(pipe->DEtoEX, pipe->EXtoMEM);
-        return;
+// A resolved branch leaves EX as a placeholder, except BL, which
+// still has the link register to write back
+static void branch_retire(const instruction* inst, instruction* out) {
+    if (inst->writeBack) {
+        pipe_reg_transfer(inst, out);
+    } else {
+        pipe_reg_transfer(&BRANCHED, out);
+        out->FLAG_Z = inst->FLAG_Z;
+        out->FLAG_N = inst->FLAG_N;
     }
-    if (pipe->DEtoEX->type == R_TYPE) {
-        pipe->DEtoEX->ALU_out = exec_R(pipe->DEtoEX);
-    } else if (pipe->DEtoEX->type == I_TYPE) {
-        pipe->DEtoEX->ALU_out = exec_I(pipe->DEtoEX);
-    } else if (pipe->DEtoEX->type == D_TYPE) {
-        //printf("offset + regs = 0x%lx + 0x%lx\n", pipe->DEtoEX->offset, CURRENT_STATE.REGS[pipe->DEtoEX->rn]);
-        if (pipe->DEtoEX->forwarded == 1) {
-            pipe->DEtoEX->effective_address = pipe->DEtoEX->offset + pipe->DEtoEX->rnVal;
-        } else {
-            pipe->DEtoEX->effective_address = pipe->DEtoEX->offset + CURRENT_STATE.REGS[pipe->DEtoEX->rn];
-        }
+}
+
+// Drop a pending iCache miss on a line other than target's, once a
+// redirect to target has made it useless.
+void fetch_cancel_miss(uint64_t target)
+{
+    // If branch address doesn't match pending miss address
+    if (pipe->missPending && 0 == cache_compare(iCache, pipe->missAddress, target)) {
+        TRACE(TRACE_DETAIL, TRACE_CACHE, "CANCEL CACHE MISS, missAddress: 0x%lx, branchAddress: 0x%lx, LineNumber: %d\n", pipe->missAddress, target, pipe->lineNumber);
+        cache_remove(iCache, pipe->missAddress, pipe->lineNumber);
+        BTRACE(TREC_MISS_CANCEL);
+        pipe->missPending = false;
+        pipe->fetch_stall = 0;
+        pipe->fetchReady = UINT64_MAX;
     }
+}
 
-    //printf("EX: pipe->DEtoEX->branch_address = %lx, offset = %lx\n", pipe->DEtoEX->branch_address, pipe->DEtoEX->offset);
-    //printf("FLAG_N: %d, FLAG_Z: %d\n", pipe->DEtoEX->FLAG_N, pipe->DEtoEX->FLAG_Z);
-    if (pipe->DEtoEX->type == CB_TYPE || pipe->DEtoEX->type == B_TYPE) {
-        instruction* new_inst = make_new_inst();
-        new_inst->valid = true;
-        new_inst->name = "Branched";
-        bool conditional;
-        pipe->btaken = exec_B(pipe->DEtoEX, &conditional);
-        bp_update(pipe->DEtoEX->branch_address, pipe->DEtoEX->current_address, conditional, pipe->btaken);
+// Execute one valid slot into out. Returns true if it redirected
+// fetch, in which case everything younger is on the wrong path.
+static bool execute_slot(instruction* inst, instruction* out)
+{
+    int taken = op_table[inst->op].exec(inst);
+
+    //printf("EX: inst->branch_address = %lx, offset = %lx\n", inst->branch_address, inst->offset);
+    //printf("FLAG_N: %d, FLAG_Z: %d\n", inst->FLAG_N, inst->FLAG_Z);
+    if (inst->type == CB_TYPE || inst->type == B_TYPE) {
+        int kind = branch_kind(inst);
+        pipe->btaken = taken;
+        if (taken) {
+            BTRACE(TREC_BR_TAKEN);
+        }
+        bool predicted_taken = inst->next_address != inst->current_address + 4;
+        // the cases below that redirect fetch
+        bool redirect = taken ? !inst->hit || inst->branch_address != inst->next_address
+                              : inst->hit && predicted_taken;
+        bp_update(inst->branch_address, inst->current_address, kind, pipe->btaken,
+                  &inst->bp_state, redirect);
+        if (kind == BTB_COND) {
+            stat_br_cond++;
+            if (predicted_taken != taken) {
+                stat_br_dir_miss++;
+            }
+        } else if (kind == BTB_RETURN) {
+            stat_br_ret++;
+            if (inst->next_address != inst->branch_address) {
+                stat_br_ret_miss++;
+            }
+        }
 
         // Conditional not taken, but predicted it would.
-        if ((pipe->DEtoEX->hit == true) && (pipe->btaken == false)) {
+        if (inst->hit == true && pipe->btaken == false && predicted_taken) {
             pipe->flush = 2;
-            CURRENT_STATE.PC = pipe->DEtoEX->current_address + 4;
-            pipe_reg_transfer(new_inst, pipe->EXtoMEM);
-            return;
+            BTRACE(TREC_BR_MISPRED);
+            CURRENT_STATE.PC = inst->current_address + 4;
+            branch_retire(inst, out);
+            return true;
         }
 
         //The instruction is a branch, but the predicted target destination does not match the actual target.
-        if (pipe->DEtoEX->branch_address != pipe->DEtoEX->next_address) {
-            printf("EX: branch_add: %lx, next_add: %lx, current_add: 0x%lx\n", pipe->DEtoEX->branch_address, pipe->DEtoEX->next_address, pipe->DEtoEX->current_address);
-            printf("miss pending? %d\n", pipe->missPending);
+        // (A not-taken branch has no branch_address; fetch predicted it
+        // correctly if it got this far.)
+        if (pipe->btaken && inst->branch_address != inst->next_address) {
+            TRACE(TRACE_DETAIL, TRACE_BRANCH, "EX: branch_add: %lx, next_add: %lx, current_add: 0x%lx\n", inst->branch_address, inst->next_address, inst->current_address);
+            TRACE(TRACE_DETAIL, TRACE_BRANCH, "miss pending? %d\n", pipe->missPending);
             pipe->flush = 2;
-            CURRENT_STATE.PC = pipe->DEtoEX->branch_address;
-            if (pipe->missPending == true) {
-                // If branch address doesn't match pending miss address
-                if (0 == cache_compare(iCache, pipe->missAddress, pipe->DEtoEX->branch_address)) {
-                    printf("CANCEL CACHE MISS, missAddress: 0x%lx, branchAddress: 0x%lx, LineNumber: %d\n", pipe->missAddress, pipe->DEtoEX->branch_address, pipe->lineNumber);
-                    cache_remove(iCache, pipe->missAddress, pipe->lineNumber);
-                    pipe->missPending = false;
-                    pipe->fetch_stall = 0;
-                }
-            }
-            
-            pipe_reg_transfer(new_inst, pipe->EXtoMEM);
-            printf("branch mispredicted.\n");
-            return;
+            BTRACE(TREC_BR_MISPRED);
+            CURRENT_STATE.PC = inst->branch_address;
+            fetch_cancel_miss(inst->branch_address);
+
+            branch_retire(inst, out);
+            TRACE(TRACE_DETAIL, TRACE_BRANCH, "branch mispredicted.\n");
+            return true;
         }
         // BTB miss
-        if (pipe->DEtoEX->hit == false) {
+        if (inst->hit == false && pipe->btaken) {
             pipe->flush = 2;
-            CURRENT_STATE.PC = pipe->DEtoEX->branch_address;
-            pipe_reg_transfer(new_inst, pipe->EXtoMEM);
-            return;
+            BTRACE(TREC_BR_MISPRED);
+            CURRENT_STATE.PC = inst->branch_address;
+            branch_retire(inst, out);
+            return true;
         }
-        pipe_reg_transfer(new_inst, pipe->EXtoMEM);
-        printf("Branch predicted correctly or untaken\n");
-        return;
+        branch_retire(inst, out);
+        TRACE(TRACE_DETAIL, TRACE_BRANCH, "Branch predicted correctly or untaken\n");
+        return false;
     }
 
-    // Insert Bubble
-    if (pipe->stall) {
-        instruction* temp = make_new_inst();
-        temp->valid = false;
-        temp->name = "bubble";
-        pipe_reg_transfer(temp, pipe->EXtoMEM);
-    } else {
-        pipe_reg_transfer(pipe->DEtoEX, pipe->EXtoMEM);
+    // A partial BTB tag can match a PC that holds no branch
+    bool redirect = inst->next_address != inst->current_address + 4;
+    if (redirect) {
+        pipe->flush = 2;
+        BTRACE(TREC_BR_MISPRED);
+        CURRENT_STATE.PC = inst->current_address + 4;
+        bp_restore(&inst->bp_state);
     }
+    pipe_reg_transfer(inst, out);
+    return redirect;
+}
 
+void pipe_stage_execute()
+{
+    for (int s = 0; s < config.width; s++) {
+        instruction* inst = &pipe->DEtoEX[s];
+        TRACE(TRACE_STAGE, TRACE_EX, "EX: %s, memRead? %d, rt: %d, rn: %d, rm: %d\n", op_name(inst), inst->memRead, inst->rt, inst->rn, inst->rm);
+        // slots see the flags of the slot ahead of them in the group
+        if (s > 0) {
+            inst->FLAG_Z = pipe->DEtoEX[s - 1].FLAG_Z;
+            inst->FLAG_N = pipe->DEtoEX[s - 1].FLAG_N;
+        }
+        if (!inst->valid) {
+            pipe_reg_transfer(inst, &pipe->EXtoMEM[s]);
+        } else if (pipe->stall) {
+            // Insert Bubble: the whole group runs again next cycle
+            pipe_reg_transfer(&BUBBLE, &pipe->EXtoMEM[s]);
+        } else {
+            uint64_t ready = stat_cycles + fu_issue(op_table[inst->op].fu);
+            bool redirect = execute_slot(inst, &pipe->EXtoMEM[s]);
+            if (inst->writeBack == 1 && inst->rt != 31) {
+                pipe->fuReady[inst->rt] = ready;
+            }
+            if (inst->flagged) {
+                pipe->fuReady[ARM_REGS] = ready;
+            }
+            if (redirect) {
+                // a HLT decoded behind the branch was on the wrong path
+                pipe->halt = -1;
+                for (s++; s < config.width; s++) {
+                    pipe_reg_transfer(&FLUSH, &pipe->EXtoMEM[s]);
+                }
+            }
+        }
+    }
+}
+
+// How many IFtoDE slots issue together this cycle. A slot waits for
+// the next group when it reads a register an older slot writes (there
+// is no forwarding inside a group), or when it would be the group's
+// second memory access (one dCache port), second branch, or one more
+// instruction than its functional unit class has units. A HLT
+// issues alone, as decode stops behind it and EX keeps re-running
+// whatever DEtoEX last held; *drop is set to discard what follows it.
+static int issue_count(bool* drop) {
+    int mem = 0, br = 0;
+    int units[NUM_FU] = { 0 };
+    *drop = false;
+    for (int n = 0; n < config.width; n++) {
+        instruction* inst = &pipe->IFtoDE[n];
+        if (!inst->valid) {
+            continue;
+        }
+        if ((inst->type == D_TYPE && mem++ > 0) ||
+            ((inst->type == CB_TYPE || inst->type == B_TYPE) && br++ > 0)) {
+            return n;
+        }
+        if (++units[op_table[inst->op].fu] > fu_units(op_table[inst->op].fu)) {
+            return n;
+        }
+        for (int o = 0; o < n; o++) {
+            instruction* older = &pipe->IFtoDE[o];
+            if (older->valid && older->writeBack && older->rt != 31 && reads_reg(inst, older->rt)) {
+                return n;
+            }
+            // flags do pass along the group, but only from one-cycle units
+            if (older->valid && op_sets_flags(older->op) && op_reads_flags(inst->op) &&
+                    fu_latency(op_table[older->op].fu) > 1) {
+                return n;
+            }
+        }
+        if (inst->hltInst) {
+            *drop = n == 0;
+            return n > 0 ? n : 1;
+        }
+    }
+    return config.width;
 }
 
 void pipe_stage_decode()
 {
-	decode(pipe->IFtoDE->fetched_instruction, pipe->IFtoDE);
+    // IFtoDE was already decoded by fetch through the predecode cache
+    bool drop;
+    int n = issue_count(&drop);
+    for (int s = 0; s < n && pipe->flush == 0; s++) {
+        if (pipe->IFtoDE[s].hltInst) {
+            pipe->halt = 0;
+        }
+    }
     // Hazard Detection
-    hazard_detection_unit();
-    printf("DE: %s X%d, ... current_add: 0x%lx\n", pipe->IFtoDE->name, pipe->IFtoDE->rt, pipe->IFtoDE->current_address);
+    hazard_detection_unit(n);
+    for (int s = 0; s < n; s++) {
+        TRACE(TRACE_STAGE, TRACE_DE, "DE: %s X%d, ... current_add: 0x%lx\n", op_name(&pipe->IFtoDE[s]), pipe->IFtoDE[s].rt, pipe->IFtoDE[s].current_address);
+    }
     if (pipe->flush > 0) {
-        instruction* temp = make_new_inst();
-        temp->valid = false;
-        temp->name = "flush";
-        pipe_reg_transfer(temp, pipe->DEtoEX);
+        fill_group(pipe->DEtoEX, &FLUSH);
+        BTRACE(TREC_FLUSH);
         pipe->flush--;
+        return;
+    }
+    for (int s = 0; s < config.width; s++) {
+        pipe_reg_transfer(s < n ? &pipe->IFtoDE[s] : &BUBBLE, &pipe->DEtoEX[s]);
+    }
+    // Keep the rest of the group for next cycle; fetch holds meanwhile
+    if (n < config.width && !drop) {
+        for (int s = 0; s < config.width; s++) {
+            pipe_reg_transfer(s + n < config.width ? &pipe->IFtoDE[s + n] : &blank_inst, &pipe->IFtoDE[s]);
+        }
+        pipe->de_hold = true;
+    }
+}
+
+// Fetch the instruction at CURRENT_STATE.PC out of the current iCache
+// line into inst and move the PC on to its predicted successor.
+static void fetch_slot(instruction* inst)
+{
+    uint32_t word;
+    *inst = blank_inst;
+    memcpy(&word, cache_data(iCache, CURRENT_STATE.PC, pipe->lineNumber), 4);
+    predecode_apply(predecode_lookup(CURRENT_STATE.PC, word), inst);
+    inst->current_address = CURRENT_STATE.PC;
+    if (config.ftq_entries > 0) {
+        const ftq_entry* e = ftq_head();
+        inst->hit = e->hit;
+        inst->bp_state = e->snap;
+        CURRENT_STATE.PC = e->next;
+        ftq_pop();
     } else {
-        pipe_reg_transfer(pipe->IFtoDE, pipe->DEtoEX);
+        CURRENT_STATE.PC = bp_predict(CURRENT_STATE.PC, &inst->hit, &inst->bp_state);
+    }
+    inst->next_address = CURRENT_STATE.PC;
+    if (inst->hit) {
+        BTRACE(TREC_BTB_HIT);
     }
+    TRACE(TRACE_STAGE, TRACE_FETCH, "FETCH: bp->HIT: %d, current_address: 0x%lx, predicted_(next)_address: 0x%lx\n", inst->hit, inst->current_address, inst->next_address);
 }
 
 void pipe_stage_fetch()
 {
-    instruction* temp = make_new_inst();
+    if (config.ftq_entries > 0) {
+        ftq_fill(CURRENT_STATE.PC, pipe->flush > 0);
+    }
     //printf("PC: %lx\n", CURRENT_STATE.PC);
 
     if (pipe->fetch_stall > 0) {
         //printf("IF: flushed--\n");
-        temp->valid = false;
-        temp->name = "cache bubble";
         //printf("    CACHING BUBBLE INSERT\n");
-        pipe_reg_transfer(temp, pipe->IFtoDE);
+        fill_group(pipe->IFtoDE, &CACHE_BUBBLE);
+        BTRACE(TREC_FETCH_STALL);
         pipe->fetch_stall--;
         if (pipe->flush > 0) {
             pipe->flush--;
@@ -511,31 +1138,52 @@ void pipe_stage_fetch()
     }
     if (pipe->flush > 0) {
         //printf("IF: flushed--\n");
-        temp->valid = false;
-        temp->name = "flush";
-        pipe_reg_transfer(temp, pipe->IFtoDE);
+        fill_group(pipe->IFtoDE, &FLUSH);
+        BTRACE(TREC_FLUSH);
         pipe->flush--;
         return;
     }
     
     else {
-        if (cache_update(iCache, CURRENT_STATE.PC, &pipe->lineNumber)) {
-            printf("iCache hit\n");
-            temp->fetched_instruction = mem_read_32(CURRENT_STATE.PC);
+        // As in MEM, the latency is paid once per PC; the retry after
+        // the stall finds the line and goes through.
+        int hit;
+        if (pipe->fetchReady == CURRENT_STATE.PC &&
+                cache_probe(iCache, CURRENT_STATE.PC, &pipe->lineNumber)) {
+            hit = 1;
         } else {
-            pipe->missAddress = CURRENT_STATE.PC;
-            pipe-> missPending = true;
-            pipe->fetch_stall = 9;
-            printf("iCache miss\n");
-            temp->name = "cache bubble";
-            pipe_reg_transfer(temp, pipe->IFtoDE);
+            hit = cache_update(iCache, CURRENT_STATE.PC, &pipe->lineNumber);
+            if (iPrefetch != NULL) {
+                prefetch_access(iPrefetch, iCache, CURRENT_STATE.PC, CURRENT_STATE.PC, hit);
+            }
+        }
+        if (iCache->last_latency > 0 && pipe->fetchReady != CURRENT_STATE.PC) {
+            if (!hit) {
+                pipe->missAddress = CURRENT_STATE.PC;
+                pipe-> missPending = true;
+                TRACE(TRACE_DETAIL, TRACE_CACHE, "iCache miss\n");
+                BTRACE(TREC_ICACHE_MISS);
+            }
+            pipe->fetch_stall = iCache->last_latency - 1;
+            pipe->fetchReady = CURRENT_STATE.PC;
+            fill_group(pipe->IFtoDE, &CACHE_BUBBLE);
             return;
         }
-        temp->current_address = CURRENT_STATE.PC;
-        CURRENT_STATE.PC = bp_predict(CURRENT_STATE.PC, &temp->hit);
-        temp->next_address = CURRENT_STATE.PC;
-        printf("FETCH: bp->HIT: %d, current_address: 0x%lx, predicted_(next)_address: 0x%lx\n", temp->hit, temp->current_address, temp->next_address);
-        pipe_reg_transfer(temp, pipe->IFtoDE);
+        pipe->fetchReady = UINT64_MAX;
+        TRACE(TRACE_DETAIL, TRACE_CACHE, "iCache hit\n");
+        BTRACE(TREC_ICACHE_HIT);
+        // One line read per cycle: the group takes sequential
+        // instructions from it up to the first predicted-taken branch
+        uint64_t line = CURRENT_STATE.PC >> iCache->b;
+        int s = 0;
+        do {
+            fetch_slot(&pipe->IFtoDE[s++]);
+        } while (s < config.width && CURRENT_STATE.PC == pipe->IFtoDE[s - 1].current_address + 4 &&
+                 CURRENT_STATE.PC >> iCache->b == line &&
+                 (config.ftq_entries == 0 || ftq_count() > 0));
+        for (; s < config.width; s++) {
+            pipe->IFtoDE[s] = blank_inst;
+        }
     }
 
 }
@@ -558,12 +1206,11 @@ int64_t takebits_extend(unsigned int input, unsigned int a, unsigned int b) {
 }
 
 // helper to set data for (extended) R-type instructions
-// rm=20-16, opt=15-13, imm=12-10, rn=9-5, rt=4-0
+// rm=20-16, opt=15-13 (unused), imm=12-10, rn=9-5, rt=4-0
 void setinst_ex_R(uint32_t input, instruction *inst) {
     inst->type = R_TYPE;
     inst->rm = takebits(input, 20, 16);
     inst->rt = takebits(input, 4, 0);
-    inst->opt = takebits(input, 15, 13);
     inst->imm = takebits(input, 12, 10);
     inst->rn = takebits(input, 9, 5);
     inst->writeBack = 1;
@@ -612,52 +1259,50 @@ void decode(uint32_t input, instruction *instruction) {
     uint32_t op21 = takebits(input, 31, 21); // bits 31 to 21
     switch (op21) {
         case 0b10001011000 :
-            instruction->name = "ADD";
+            instruction->op = OP_ADD_R;
             setinst_sh_R(input, instruction);
             return;
         case 0b10101011001 :
-            instruction->name = "ADDS";
+            instruction->op = OP_ADDS_R;
             setinst_ex_R(input, instruction);
             return;
         case 0b10101011000 :
-            instruction->name = "ADDS";
+            instruction->op = OP_ADDS_R;
             setinst_sh_R(input, instruction);
             return;
         case 0b10001010000 :
-            instruction->name = "AND";
+            instruction->op = OP_AND;
             setinst_sh_R(input, instruction);
             return;
         case 0b11101010000 :
-            instruction->name = "ANDS";
+            instruction->op = OP_ANDS;
             setinst_sh_R(input, instruction);
             return;
         case 0b10101010000 :
-            instruction->name = "ORR";
+            instruction->op = OP_ORR;
             setinst_sh_R(input, instruction);
             return;
         case 0b11101011000 :
             setinst_sh_R(input, instruction);
             if (instruction->rt == 0b11111) {
-                instruction->name = "CMP";
+                instruction->op = OP_CMP_R;
                 instruction->writeBack = 0;
             } else {
-                instruction->name = "SUBS";
+                instruction->op = OP_SUBS_R;
             }
             return;
         case 0b11001010000 :
-            instruction->name = "EOR";
+            instruction->op = OP_EOR;
             setinst_sh_R(input, instruction);
             return;
         case 0b11010100010 :
-            instruction->name = "HLT";
+            instruction->op = OP_HLT;
             instruction->imm = takebits(input, 20, 5);
-            instruction->op2 = takebits(input, 4, 2);
             instruction->hltInst = true;
             instruction-> valid = true;
-            pipe->halt = 3;
             return;
         case 0b11111000010 :
-            instruction->name = "LDUR";
+            instruction->op = OP_LDUR;
             setinst_D(input, instruction);
             instruction->memRead = true;
             instruction->memWrite = false;
@@ -665,7 +1310,7 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->writeBack = 2;
             return;
         case 0b00111000010 :
-            instruction->name = "LDURB";
+            instruction->op = OP_LDURB;
             setinst_D(input, instruction);
             instruction->memRead = true;
             instruction->memWrite = false;
@@ -673,7 +1318,7 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->writeBack = 2;
             return;
         case 0b01111000010 :
-            instruction->name = "LDURH";
+            instruction->op = OP_LDURH;
             setinst_D(input, instruction);
             instruction->memRead = true;
             instruction->memWrite = false;
@@ -681,7 +1326,7 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->writeBack = 2;
             return;
         case 0b11111000000 :
-            instruction->name = "STUR";
+            instruction->op = OP_STUR;
             setinst_D(input, instruction);
             instruction->memWrite = true;
             instruction->memRead = false;
@@ -689,7 +1334,7 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->writeBack = 0;
             return;
         case 0b00111000000 :
-            instruction->name = "STURB";
+            instruction->op = OP_STURB;
             setinst_D(input, instruction);
             instruction->memWrite = true;
             instruction->memRead = false;
@@ -697,7 +1342,7 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->writeBack = 0;
             return;
         case 0b01111000000 :
-            instruction->name = "STURH";
+            instruction->op = OP_STURH;
             setinst_D(input, instruction);
             instruction->memWrite = true;
             instruction->memRead = false;
@@ -705,19 +1350,19 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->writeBack = 0;
             return;
         case 0b11001011001 :
-            instruction->name = "SUB";
+            instruction->op = OP_SUB_R;
             setinst_ex_R(input, instruction);
             return;
         case 0b11001011000 :
-            instruction->name = "SUB";
+            instruction->op = OP_SUB_R;
             setinst_sh_R(input, instruction);
             return;
         case 0b11101011001 :
-            instruction->name = "SUBS";
+            instruction->op = OP_SUBS_R;
             setinst_ex_R(input, instruction);
             return;
         case 0b10011011000 :
-            instruction->name = "MUL";
+            instruction->op = OP_MUL;
             instruction->type = R_TYPE;
             // rm=20-16, 0, 1=ra=14-10, rn=9-5, rt=4-0
             instruction->rm = takebits(input, 20, 16);
@@ -728,10 +1373,9 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->memRead, instruction->memWrite = false;
             return;
         case 0b11010110000 :
-            instruction->name = "BR";
+            instruction->op = OP_BR;
             instruction->type = B_TYPE;
             // br: op2=20-16, op3=15-10, rn=9-5, op4=4-0
-            instruction->op2 = takebits(input, 20, 16);
             instruction->rn = takebits(input, 9, 5);
             instruction->valid = true;
             return;
@@ -739,24 +1383,24 @@ void decode(uint32_t input, instruction *instruction) {
     uint32_t op22 = takebits(input, 31, 22); // bits 31 to 22
     switch (op22) {
         case 0b1001000100 :
-            instruction->name = "ADD";
+            instruction->op = OP_ADD_I;
             setinst_I(input, instruction);
             return;
         case 0b1011000100 :
-            instruction->name = "ADDS";
+            instruction->op = OP_ADDS_I;
             setinst_I(input, instruction);
             return;
         case 0b1111000100 :
             setinst_I(input, instruction);
             if (instruction->rt == 0b11111) {
-                instruction->name = "CMP";
+                instruction->op = OP_CMP_I;
                 instruction->writeBack = 0;
             } else {
-                instruction->name = "SUBS";
+                instruction->op = OP_SUBS_I;
             }
             return;
         case 0b1101000100 :
-            instruction->name = "SUB";
+            instruction->op = OP_SUB_I;
             setinst_I(input, instruction);
             return;
         case 0b1101001101 :
@@ -770,9 +1414,9 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->valid = true;
             instruction->rt = takebits(input, 4, 0);
             if ((instruction->imm == 0b111111) || (instruction->imm == 0b011111)) {
-                instruction->name = "LSR";
+                instruction->op = OP_LSR;
             } else {
-                instruction->name = "LSL";
+                instruction->op = OP_LSL;
             }
             return;
     }
@@ -782,9 +1426,8 @@ void decode(uint32_t input, instruction *instruction) {
             instruction->valid = true;
             instruction->memRead, instruction->memWrite = false;
             instruction->writeBack = true;
-            instruction->name = "MOVZ";
+            instruction->op = OP_MOVZ;
             instruction->type = I_TYPE;
-            instruction->hw = takebits(input, 22, 21);
             instruction->imm = takebits(input, 20, 5);
             instruction->rt = takebits(input, 4, 0);
             return;
@@ -794,41 +1437,41 @@ void decode(uint32_t input, instruction *instruction) {
     switch (op24) {
         case 0b10110100 :
             instruction->valid = true;
-            instruction->name = "CBZ";
+            instruction->op = OP_CBZ;
             instruction->type = CB_TYPE;
             instruction->offset = takebits_extend(input, 23, 5);
             instruction->rt = takebits(input, 4, 0);
             return;
         case 0b10110101 :
             instruction->valid = true;
-            instruction->name = "CBNZ";
+            instruction->op = OP_CBNZ;
             instruction->type = CB_TYPE;
             instruction->offset = takebits_extend(input, 23, 5);
             instruction->rt = takebits(input, 4, 0);
             return;
         case 0b01010100 :
             instruction->valid = true;
+            instruction->op = OP_BCOND;
             instruction->type = CB_TYPE;
             instruction->offset = takebits_extend(input, 23, 5);
-            instruction->condBR = takebits(input, 3, 0);
-            switch (instruction->condBR) {
+            switch (takebits(input, 3, 0)) {
                 case 0b0000 :
-                    instruction->name = "BEQ";
+                    instruction->op = OP_BEQ;
                     return;
                 case 0b0001 :
-                    instruction->name = "BNE";
+                    instruction->op = OP_BNE;
                     return;
                 case 0b1100 :
-                    instruction->name = "BGT";
+                    instruction->op = OP_BGT;
                     return;
                 case 0b1011 :
-                    instruction->name = "BLT";
+                    instruction->op = OP_BLT;
                     return;
                 case 0b1010 :
-                    instruction->name = "BGE";
+                    instruction->op = OP_BGE;
                     return;
                 case 0b1101 :
-                    instruction->name = "BLE";
+                    instruction->op = OP_BLE;
                     return;
             }
     }
@@ -837,10 +1480,18 @@ void decode(uint32_t input, instruction *instruction) {
     switch (op26) {
         case 0b000101 :
             instruction->valid = true;
-            instruction->name = "B";
+            instruction->op = OP_B;
             instruction->type = B_TYPE;
             instruction->offset = takebits_extend(input, 25, 0);
             return;
+        case 0b100101 :
+            instruction->valid = true;
+            instruction->op = OP_BL;
+            instruction->type = B_TYPE;
+            instruction->offset = takebits_extend(input, 25, 0);
+            instruction->rt = 30;
+            instruction->writeBack = 1;
+            return;
     }
 }
 
@@ -860,138 +1511,131 @@ void setflags(int n, instruction* inst)
     }
     inst->flagged = true;
 }
-int64_t exec_R(instruction* inst) {
-    int64_t temp;
-    if (!inst->forwarded) {
-        inst->rmVal = CURRENT_STATE.REGS[inst->rm];
-        inst->rnVal = CURRENT_STATE.REGS[inst->rn];
-    } else if (inst->forwarded == 1) {
+// Operand fetch for register-register ops, honouring EX/MEM forwarding
+void read_R(instruction* inst) {
+    if (!(inst->forwarded & FWD_RM)) {
         inst->rmVal = CURRENT_STATE.REGS[inst->rm];
-    } else if (inst->forwarded = 2) {
-        inst->rnVal = CURRENT_STATE.REGS[inst->rn];
     }
-
-    if (strcmp(inst->name, "ADD") == 0) {
-        temp = inst->rmVal + inst->rnVal;
-    }
-    else if (strcmp(inst->name, "ADDS") == 0) {
-        temp = inst->rmVal + inst->rnVal;
-        setflags(temp, inst);
-    } 
-    else if (strcmp(inst->name, "SUB") == 0) {
-        temp = inst->rnVal - inst->rmVal;
-    }
-    else if ((strcmp(inst->name, "SUBS") == 0) || (strcmp(inst->name, "CMP") == 0)) {
-        temp = inst->rnVal - inst->rmVal;
-        setflags(temp, inst);
-    } 
-    else if (strcmp(inst->name, "MUL") == 0) {
-        temp = inst->rnVal * inst->rmVal;
-    }
-    else if (strcmp(inst->name, "AND") == 0) {
-        temp = inst->rnVal & inst->rmVal;
-    }
-    else if (strcmp(inst->name, "ANDS") == 0) {
-        temp = inst->rnVal & inst->rmVal;
-        setflags(temp, inst);
-    }
-    else if (strcmp(inst->name, "EOR") == 0) {
-        temp = inst->rnVal ^ inst->rmVal;
-    }
-    else if (strcmp(inst->name, "ORR") == 0) {
-        temp = inst->rnVal | inst->rmVal;
+    if (!(inst->forwarded & FWD_RN)) {
+        inst->rnVal = CURRENT_STATE.REGS[inst->rn];
     }
-    return temp;
 }
 
-int64_t exec_I(instruction* inst) {
-    int64_t temp;
-
-    if (inst->forwarded != 1) {
+void read_I(instruction* inst) {
+    if (!(inst->forwarded & FWD_RN)) {
         inst->rnVal = CURRENT_STATE.REGS[inst->rn];
     }
-    if (strcmp(inst->name, "ADD") == 0) {
-        temp = inst->rnVal + inst->imm;
-    }
-    else if (strcmp(inst->name, "ADDS") == 0) {
-        temp = inst->rnVal + inst->imm;
-        setflags(temp, inst);
-    }
-    else if (strcmp(inst->name, "SUB") == 0) {
-        temp = inst->rnVal - inst->imm;
-    }
-    else if ((strcmp(inst->name, "SUBS") == 0) || (strcmp(inst->name, "CMP") == 0)) {
-        temp = inst->rnVal - inst->imm;
-        setflags(temp, inst);
-    } 
-    else if (strcmp(inst->name, "LSL") == 0) {
-        temp = inst->rnVal << (63 - (int64_t)inst->imm);
-    }
-    else if (strcmp(inst->name, "LSR") == 0) {
-        temp = inst->rnVal >> inst->shamt;
-    }
-    else if (strcmp(inst->name, "MOVZ") == 0) {
-        temp = inst->imm;
-    }
-    return temp;
 }
 
-int exec_B(instruction* inst, bool* conditional) {
+void read_B(instruction* inst) {
     if (inst->offset == 0) {
         fprintf(stderr, "Fatal error: offset uninitialized. exec_B.\n");
         exit(1);
     }
-    if (inst->forwarded != 3) {
+    if (!(inst->forwarded & FWD_RT)) {
         inst->rtVal = CURRENT_STATE.REGS[inst->rt];
     }
+}
 
-    //printf("BRANCH INSTRUCTION: FLAG_Z: %d, FLAG_N: %d\n", inst->FLAG_Z, inst->FLAG_N);
-
-    *conditional = true;
-    bool taken = false;
-    if ((strcmp(inst->name, "CBZ") == 0) && (inst->rtVal == 0)) {
-        inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
-    }
-    else if ((strcmp(inst->name, "CBNZ") == 0) && (inst->rtVal != 0)) {
-        inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
-    }
-    else if ((strcmp(inst->name, "BEQ") == 0) && inst->FLAG_Z) {
-        inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
-    }
-    else if ((strcmp(inst->name, "BNE") == 0) && !inst->FLAG_Z) {
-        inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
-    }
-    else if ((strcmp(inst->name, "BGT") == 0) && !(inst->FLAG_N || inst->FLAG_Z)) {
+int take_branch(instruction* inst, bool cond) {
+    if (cond) {
         inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
-    }
-    else if ((strcmp(inst->name, "BLT") == 0) && inst->FLAG_N) {
-        inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
-    }
-    else if ((strcmp(inst->name, "BGE") == 0) && !inst->FLAG_N) {
-        inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
-    }
-    else if ((strcmp(inst->name, "BLE") == 0) && (inst->FLAG_N || inst->FLAG_Z)) {
-        inst->branch_address = inst->offset + inst->current_address;
-        taken = true;
     }
+    return cond;
+}
 
-    // Unconditional Branches
-    if (strcmp(inst->name, "B") == 0) {
-        inst->branch_address = inst->offset + inst->current_address;
-        *conditional = false;
-        taken = true;
-    }
-    else if (strcmp(inst->name, "BR") == 0) {
-        inst->branch_address = inst->rtVal+ inst->current_address;
-        *conditional = false;
-        taken = true;
+int exec_nop(instruction* inst) { return 0; }
+
+int exec_add_r(instruction* inst) { read_R(inst); inst->ALU_out = inst->rmVal + inst->rnVal; return 0; }
+int exec_adds_r(instruction* inst) { exec_add_r(inst); setflags(inst->ALU_out, inst); return 0; }
+int exec_sub_r(instruction* inst) { read_R(inst); inst->ALU_out = inst->rnVal - inst->rmVal; return 0; }
+int exec_subs_r(instruction* inst) { exec_sub_r(inst); setflags(inst->ALU_out, inst); return 0; }
+int exec_mul(instruction* inst) { read_R(inst); inst->ALU_out = inst->rnVal * inst->rmVal; return 0; }
+int exec_and(instruction* inst) { read_R(inst); inst->ALU_out = inst->rnVal & inst->rmVal; return 0; }
+int exec_ands(instruction* inst) { exec_and(inst); setflags(inst->ALU_out, inst); return 0; }
+int exec_eor(instruction* inst) { read_R(inst); inst->ALU_out = inst->rnVal ^ inst->rmVal; return 0; }
+int exec_orr(instruction* inst) { read_R(inst); inst->ALU_out = inst->rnVal | inst->rmVal; return 0; }
+
+int exec_add_i(instruction* inst) { read_I(inst); inst->ALU_out = inst->rnVal + inst->imm; return 0; }
+int exec_adds_i(instruction* inst) { exec_add_i(inst); setflags(inst->ALU_out, inst); return 0; }
+int exec_sub_i(instruction* inst) { read_I(inst); inst->ALU_out = inst->rnVal - inst->imm; return 0; }
+int exec_subs_i(instruction* inst) { exec_sub_i(inst); setflags(inst->ALU_out, inst); return 0; }
+int exec_lsl(instruction* inst) { read_I(inst); inst->ALU_out = inst->rnVal << (63 - (int64_t)inst->imm); return 0; }
+int exec_lsr(instruction* inst) { read_I(inst); inst->ALU_out = inst->rnVal >> inst->shamt; return 0; }
+int exec_movz(instruction* inst) { read_I(inst); inst->ALU_out = inst->imm; return 0; }
+
+int exec_mem(instruction* inst) {
+    if (inst->forwarded & FWD_RN) {
+        inst->effective_address = inst->offset + inst->rnVal;
+    } else {
+        inst->effective_address = inst->offset + CURRENT_STATE.REGS[inst->rn];
     }
-    return taken;
+    return 0;
 }
+
+int exec_cbz(instruction* inst) { read_B(inst); return take_branch(inst, inst->rtVal == 0); }
+int exec_cbnz(instruction* inst) { read_B(inst); return take_branch(inst, inst->rtVal != 0); }
+int exec_beq(instruction* inst) { read_B(inst); return take_branch(inst, inst->FLAG_Z); }
+int exec_bne(instruction* inst) { read_B(inst); return take_branch(inst, !inst->FLAG_Z); }
+int exec_bgt(instruction* inst) { read_B(inst); return take_branch(inst, !(inst->FLAG_N || inst->FLAG_Z)); }
+int exec_blt(instruction* inst) { read_B(inst); return take_branch(inst, inst->FLAG_N); }
+int exec_bge(instruction* inst) { read_B(inst); return take_branch(inst, !inst->FLAG_N); }
+int exec_ble(instruction* inst) { read_B(inst); return take_branch(inst, inst->FLAG_N || inst->FLAG_Z); }
+int exec_bcond(instruction* inst) { read_B(inst); return 0; }
+int exec_b(instruction* inst) { read_B(inst); return take_branch(inst, true); }
+int exec_bl(instruction* inst) {
+    inst->ALU_out = inst->current_address + 4;
+    return exec_b(inst);
+}
+int exec_br(instruction* inst) {
+    read_I(inst);
+    inst->branch_address = inst->rnVal;
+    return 1;
+}
+
+// Indexed by opcode. exec returns 1 for a taken branch.
+const op_info op_table[NUM_OPCODES] = {
+    [OP_NONE]         = { "",          exec_nop,    false, FU_NONE },
+    [OP_ADD_R]        = { "ADD",       exec_add_r,  false, FU_ALU },
+    [OP_ADDS_R]       = { "ADDS",      exec_adds_r, false, FU_ALU },
+    [OP_SUB_R]        = { "SUB",       exec_sub_r,  false, FU_ALU },
+    [OP_SUBS_R]       = { "SUBS",      exec_subs_r, false, FU_ALU },
+    [OP_CMP_R]        = { "CMP",       exec_subs_r, false, FU_ALU },
+    [OP_MUL]          = { "MUL",       exec_mul,    false, FU_MUL },
+    [OP_AND]          = { "AND",       exec_and,    false, FU_ALU },
+    [OP_ANDS]         = { "ANDS",      exec_ands,   false, FU_ALU },
+    [OP_EOR]          = { "EOR",       exec_eor,    false, FU_ALU },
+    [OP_ORR]          = { "ORR",       exec_orr,    false, FU_ALU },
+    [OP_ADD_I]        = { "ADD",       exec_add_i,  false, FU_ALU },
+    [OP_ADDS_I]       = { "ADDS",      exec_adds_i, false, FU_ALU },
+    [OP_SUB_I]        = { "SUB",       exec_sub_i,  false, FU_ALU },
+    [OP_SUBS_I]       = { "SUBS",      exec_subs_i, false, FU_ALU },
+    [OP_CMP_I]        = { "CMP",       exec_subs_i, false, FU_ALU },
+    [OP_LSL]          = { "LSL",       exec_lsl,    false, FU_ALU },
+    [OP_LSR]          = { "LSR",       exec_lsr,    false, FU_ALU },
+    [OP_MOVZ]         = { "MOVZ",      exec_movz,   false, FU_ALU },
+    [OP_LDUR]         = { "LDUR",      exec_mem,    false, FU_NONE },
+    [OP_LDURB]        = { "LDURB",     exec_mem,    false, FU_NONE },
+    [OP_LDURH]        = { "LDURH",     exec_mem,    false, FU_NONE },
+    [OP_STUR]         = { "STUR",      exec_mem,    false, FU_NONE },
+    [OP_STURB]        = { "STURB",     exec_mem,    false, FU_NONE },
+    [OP_STURH]        = { "STURH",     exec_mem,    false, FU_NONE },
+    [OP_CBZ]          = { "CBZ",       exec_cbz,    true,  FU_NONE },
+    [OP_CBNZ]         = { "CBNZ",      exec_cbnz,   true,  FU_NONE },
+    [OP_BEQ]          = { "BEQ",       exec_beq,    true,  FU_NONE },
+    [OP_BNE]          = { "BNE",       exec_bne,    true,  FU_NONE },
+    [OP_BGT]          = { "BGT",       exec_bgt,    true,  FU_NONE },
+    [OP_BLT]          = { "BLT",       exec_blt,    true,  FU_NONE },
+    [OP_BGE]          = { "BGE",       exec_bge,    true,  FU_NONE },
+    [OP_BLE]          = { "BLE",       exec_ble,    true,  FU_NONE },
+    [OP_BCOND]        = { "",          exec_bcond,  true,  FU_NONE },
+    [OP_B]            = { "B",         exec_b,      false, FU_NONE },
+    [OP_BL]           = { "BL",        exec_bl,     false, FU_NONE },
+    [OP_BR]           = { "BR",        exec_br,     false, FU_NONE },
+    [OP_HLT]          = { "HLT",       exec_nop,    false, FU_NONE },
+    [OP_BUBBLE]       = { "bubble",              exec_nop, false, FU_NONE },
+    [OP_CACHE_BUBBLE] = { "cache bubble",        exec_nop, false, FU_NONE },
+    [OP_FLUSH]        = { "flush",               exec_nop, false, FU_NONE },
+    [OP_DCACHE_STALL] = { "dCache stall bubble", exec_nop, false, FU_NONE },
+    [OP_BRANCHED]     = { "Branched",            exec_nop, false, FU_NONE },
+};
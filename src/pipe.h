@@ -8,8 +8,12 @@
 #define _PIPE_H_
 
 #include "shell.h"
+#include "config.h"
+#include "bp.h"
+#include "fu.h"
 #include "stdbool.h"
 #include <limits.h>
+#include <stdio.h>
 
 // SIM.c stuff
 
@@ -22,49 +26,84 @@ typedef enum {
     NO_TYPE
 } inst_type;
 
-//instruction carries all information along the pipeline
+// Dense opcode set emitted by decode(); op_table maps each to a handler.
+typedef enum {
+    OP_NONE,
+    // register-register ALU
+    OP_ADD_R, OP_ADDS_R, OP_SUB_R, OP_SUBS_R, OP_CMP_R,
+    OP_MUL, OP_AND, OP_ANDS, OP_EOR, OP_ORR,
+    // immediate ALU
+    OP_ADD_I, OP_ADDS_I, OP_SUB_I, OP_SUBS_I, OP_CMP_I,
+    OP_LSL, OP_LSR, OP_MOVZ,
+    // loads / stores
+    OP_LDUR, OP_LDURB, OP_LDURH, OP_STUR, OP_STURB, OP_STURH,
+    // branches
+    OP_CBZ, OP_CBNZ, OP_BEQ, OP_BNE, OP_BGT, OP_BLT, OP_BGE, OP_BLE, OP_BCOND,
+    OP_B, OP_BL, OP_BR,
+    OP_HLT,
+    // pipeline placeholders, never decoded
+    OP_BUBBLE, OP_CACHE_BUBBLE, OP_FLUSH, OP_DCACHE_STALL, OP_BRANCHED,
+    NUM_OPCODES
+} opcode;
+
+// instruction.forwarded bits
+#define FWD_RN 1
+#define FWD_RM 2
+#define FWD_RT 4
+
+//instruction carries all information along the pipeline.
+//Laid out hot-first and packed: the latches are copied whole every cycle.
 typedef struct instruction {
-    char *name; 
-    inst_type type;
-    //  Decode Information
+    // Decode / control, read by the hazard units every cycle
+    uint8_t op; // opcode
+    uint8_t type; // inst_type
+    uint8_t rn, rm, rt; // rt for targeted (destination) reg
+    uint8_t writeBack; // 0: don't write, 1: WB ALU, 2: WB mem_val
+    uint8_t loadBytes; // 0 = not a load function. 1 = Read 64, 2 = read 16, 3 = read 8 bits;
+    uint8_t forwarded; // FWD_* bits: operands already supplied by forwarding
+    bool valid;
+    bool memRead;
+    bool memWrite;
+    bool hltInst;
+    bool flagged;
+    bool FLAG_N;
+    bool FLAG_Z;
+    bool hit; // BTB hit at fetch
+    bp_snap bp_state; // predictor state the fetch prediction started from
+    uint8_t shamt; // shift amount OR load offset
+    uint16_t imm; // immediate value for calculations
+    uint32_t fetched_instruction; // raw word, debug only
 
-    uint32_t rn, rm, rt; // rd = destination reg, rt for targeted reg
+    // Operands and results
     int64_t rnVal, rmVal, rtVal;
-    uint32_t opt; // option
-    uint32_t imm; // immediate value for calculations
-    uint32_t shamt; // shift amount OR load offset
-    uint32_t BR;
+    int64_t ALU_out;
+    int64_t mem_out;
     int64_t offset; // branch offsets for PC
-    uint32_t condBR;
-    uint32_t hw; // in MOVZ
-    uint32_t op2;
-    bool hltInst;
-    bool hit;
-    bool valid;
+    uint64_t effective_address;
 
-    //IFtoDE info
-    uint32_t fetched_instruction;
-    uint64_t next_address; // address
+    // Addresses
     uint64_t current_address;
+    uint64_t next_address; // predicted
     uint64_t branch_address;
-    bool flagged;
-    int forwarded; // 0 none, 1 rn, 2 rm, 3 rt;
-
-    //MEM, WBinfo
-    uint64_t effective_address;
-	int64_t ALU_out;
-    int64_t mem_out;
-    bool memWrite;
-    bool memRead;
-    int writeBack; // 0: don't write, 1: WB ALU, 2: WB mem_val
-    int loadBytes; // 0 = not a load function. 1 = Read 32, 2 = read 16, 3 = read 8 bits;
-
-    // Cache Info
-
-    bool FLAG_N;
-    bool FLAG_Z;
 } instruction;
 
+// Pre-decoded instruction cache, direct mapped on the fetch PC.
+// Fetch copies a ready record into IFtoDE so decode() runs once per PC.
+#define PREDECODE_ENTRIES 4096
+
+typedef struct predecode {
+    uint64_t pc;
+    int64_t offset;
+    uint32_t word;
+    uint16_t imm;
+    uint8_t op, type;
+    uint8_t rn, rm, rt;
+    uint8_t shamt;
+    uint8_t writeBack, loadBytes;
+    bool filled; // entry holds the decoding of word at pc
+    bool valid, hltInst, memRead, memWrite;
+} predecode;
+
 typedef struct CPU_State {
 	/* register file state */
 	int64_t REGS[ARM_REGS];
@@ -76,13 +115,24 @@ typedef struct CPU_State {
 	
 } CPU_State;
 
+enum { IF_DE, DE_EX, EX_MEM, MEM_WB, NUM_LATCHES };
+
+// Miss status holding register: one outstanding dCache line fill
+typedef struct {
+    uint64_t line; // block-aligned address
+    uint64_t ready; // cycle the fill returns; free once reached
+} mshr_t;
+
+// Each latch holds a group of config.width slots, oldest first. With a
+// width of 1 only slot 0 is used and the pipe is the original scalar one.
 typedef struct PIPE {
-    instruction* IFtoDE;
-    instruction* DEtoEX;
-    instruction* EXtoMEM;
-    instruction* MEMtoWB;
+    instruction latch[NUM_LATCHES][MAX_WIDTH]; // pipeline registers, held inline
+    instruction* IFtoDE; // latch[IF_DE]
+    instruction* DEtoEX; // latch[DE_EX]
+    instruction* EXtoMEM; // latch[EX_MEM]
+    instruction* MEMtoWB; // latch[MEM_WB]
     int stall;
-    int halt;
+    int halt; // -1, or 0 from decoding a HLT until it retires; fetch stops meanwhile
     int btaken;
     int flush;
     // Cache Things
@@ -91,12 +141,30 @@ typedef struct PIPE {
     uint64_t missAddress;
     int lineNumber;
     int memStall;
+    bool de_hold; // decode kept part of its group back, so fetch waits
+    uint64_t fetchReady; // PC whose fetch latency has been paid
+    bool memReady; // MEM's access latency has been paid
+    // Non-blocking dCache (config.mshrs > 0)
+    mshr_t mshr[MAX_MSHRS];
+    uint64_t regReady[ARM_REGS]; // first cycle EX may read the register
+    // Functional units: first cycle EX may use a unit's result (flags last)
+    uint64_t fuReady[ARM_REGS + 1];
 } PIPE;
 
-int RUN_BIT;
+extern int RUN_BIT;
 
 extern PIPE* pipe;
 
+/* blank latch template; see pipe.c */
+extern const instruction blank_inst;
+
+/* instructions allocated from the heap since startup */
+extern uint32_t stat_inst_alloc;
+
+/* non-blocking dCache: merged misses, cycles MEM waited for a free
+   MSHR, cycles EX waited on a pending load */
+extern uint32_t stat_mshr_merge, stat_mshr_full, stat_reg_wait;
+
 /* global variable -- pipeline state */
 extern CPU_State CURRENT_STATE;
 
@@ -106,6 +174,10 @@ void pipe_init();
 /* this function calls the others */
 void pipe_cycle();
 
+/* empty the pipeline; pipe_squash returns the oldest unretired PC */
+void pipe_reset(PIPE* p);
+uint64_t pipe_squash();
+
 /* each of these functions implements one stage of the pipeline */
 void pipe_stage_fetch();
 void pipe_stage_decode();
@@ -113,13 +185,19 @@ void pipe_stage_execute();
 void pipe_stage_mem();
 void pipe_stage_wb();
 
+/* called by mem_write_32 when a word in the text segment changes */
+void predecode_invalidate(uint64_t address);
+void predecode_flush();
+
+/* checkpoint hooks for CURRENT_STATE, RUN_BIT and the pipeline */
+int pipe_save(FILE* f);
+int pipe_load(FILE* f);
 
-#endif
 void exep_help(PIPE p);
 
 void mem_hazard();
 void ex_hazard();
-void hazard_detection_unit();
+void hazard_detection_unit(int n);
 
 int64_t sign_extend(uint64_t value, unsigned int n);
 uint32_t takebits(uint32_t input, uint32_t a, uint32_t b);
@@ -129,8 +207,40 @@ void setinst_sh_R(uint32_t input, instruction *inst);
 void setinst_I(uint32_t input, instruction *inst);
 void setinst_D(uint32_t input, instruction *inst);
 void decode(uint32_t input, instruction *instruction);
+predecode* predecode_lookup(uint64_t pc, uint32_t word);
+void predecode_apply(predecode* p, instruction* inst);
+
+void mem_data_access(instruction* inst);
+/* the 4 bytes a store writes; false for a D-type that stores nothing */
+bool store_word(const instruction* inst, uint32_t* word);
+
+/* after a redirect to target, drop a pending iCache miss on another line */
+void fetch_cancel_miss(uint64_t target);
 
 void setflags(int n, instruction* inst);
-int64_t exec_R(instruction* inst);
-int64_t exec_I(instruction* inst);
-int exec_B(instruction* inst, bool* conditional);
+void read_R(instruction* inst);
+void read_I(instruction* inst);
+void read_B(instruction* inst);
+
+// Execute handler per opcode: computes ALU_out / effective_address /
+// branch_address in place and returns 1 for a taken branch.
+typedef int (*exec_fn)(instruction* inst);
+
+typedef struct {
+    const char* name; // for printing only
+    exec_fn exec;
+    bool conditional; // conditional branch, trains the direction predictor
+    uint8_t fu; // fu_kind that executes it
+} op_info;
+
+extern const op_info op_table[NUM_OPCODES];
+#define op_name(inst) (op_table[(inst)->op].name)
+
+/* btb_kind of a branch, for the BTB and return stack */
+int branch_kind(const instruction* inst);
+
+/* does the opcode write the N/Z flags, or read them? */
+bool op_sets_flags(int op);
+bool op_reads_flags(int op);
+
+#endif
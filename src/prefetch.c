@@ -0,0 +1,240 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "prefetch.h"
+#include "shell.h"
+#include "checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PF_LINE_NONE UINT64_MAX
+
+const char* const pf_names[NUM_PF + 1] = {
+    "none", "nextline", "stride", "stream", "fdp", NULL
+};
+
+prefetcher* iPrefetch = NULL;
+prefetcher* dPrefetch = NULL;
+
+// Block of the demand access being trained on. Its caller still holds
+// the way that access returned, so no fill may go into its set.
+static uint64_t pf_demand = PF_LINE_NONE;
+
+// Fill the block numbered `line` unless it is already resident. The
+// line is tracked until a demand access uses it or the ring wraps.
+static void pf_issue(prefetcher* pf, cache_t* c, uint64_t line) {
+    uint64_t addr = line << c->b;
+    int way;
+    if (pf_demand != PF_LINE_NONE && ((line ^ pf_demand) & (c->set_no - 1)) == 0) {
+        return;
+    }
+    if (cache_probe(c, addr, &way)) {
+        return;
+    }
+    cache_update(c, addr, &way);
+    pf->track[pf->track_next].line = line;
+    pf->track[pf->track_next].ready = stat_cycles + c->last_latency;
+    pf->track_next = (pf->track_next + 1) % PF_TRACK;
+    pf->issued++;
+}
+
+static void pf_nextline(prefetcher* pf, cache_t* c, uint64_t pc, uint64_t addr, int trigger) {
+    if (!trigger) {
+        return;
+    }
+    for (int i = 1; i <= pf->degree; i++) {
+        pf_issue(pf, c, (addr >> c->b) + i);
+    }
+}
+
+// Classic reference prediction table: trains on every access and
+// prefetches once the same stride has been seen twice in a row.
+static void pf_stride(prefetcher* pf, cache_t* c, uint64_t pc, uint64_t addr, int trigger) {
+    pf_rpt_t* e = &pf->rpt[(pc >> 2) & (PF_RPT - 1)];
+    if (e->pc != pc) {
+        e->pc = pc;
+        e->last = addr;
+        e->stride = 0;
+        e->conf = 0;
+        return;
+    }
+    int64_t stride = addr - e->last;
+    e->last = addr;
+    if (stride == e->stride) {
+        if (e->conf < 3) {
+            e->conf++;
+        }
+    } else if (e->conf > 0) {
+        e->conf--;
+    } else {
+        e->stride = stride;
+    }
+    if (e->conf < 2 || e->stride == 0) {
+        return;
+    }
+    for (int i = 1; i <= pf->degree; i++) {
+        uint64_t line = (addr + i * e->stride) >> c->b;
+        if (line != addr >> c->b) {
+            pf_issue(pf, c, line);
+        }
+    }
+}
+
+// A trigger within two lines of a tracked stream extends it; the
+// second one fixes its direction and from then on each trigger runs
+// `degree` lines ahead. Anything else starts a new stream in the
+// least recently used tracker.
+static void pf_stream(prefetcher* pf, cache_t* c, uint64_t pc, uint64_t addr, int trigger) {
+    if (!trigger) {
+        return;
+    }
+    uint64_t line = addr >> c->b;
+    pf_stream_t* s = NULL;
+    pf_stream_t* lru = &pf->stream[0];
+    pf->clock++;
+    for (int i = 0; i < PF_STREAMS; i++) {
+        int64_t d = line - pf->stream[i].last;
+        if (pf->stream[i].used != 0 && d >= -2 && d <= 2) {
+            s = &pf->stream[i];
+            break;
+        }
+        if (pf->stream[i].used < lru->used) {
+            lru = &pf->stream[i];
+        }
+    }
+    if (s == NULL) {
+        lru->last = line;
+        lru->dir = 0;
+        lru->used = pf->clock;
+        return;
+    }
+    int dir = line > s->last ? 1 : line < s->last ? -1 : s->dir;
+    if (s->dir == 0) {
+        s->dir = dir;
+    }
+    s->last = line;
+    s->used = pf->clock;
+    if (s->dir == 0 || dir != s->dir) {
+        return;
+    }
+    for (int i = 1; i <= pf->degree; i++) {
+        pf_issue(pf, c, line + i * s->dir);
+    }
+}
+
+// The fetch target queue issues these through prefetch_issue
+static void pf_fdp(prefetcher* pf, cache_t* c, uint64_t pc, uint64_t addr, int trigger) {
+}
+
+// Indexed by pf_kind. train sees every demand access; `trigger` is set
+// for misses and for the first use of a prefetched line, so a stream
+// that prefetching has turned into hits keeps running.
+typedef struct {
+    void (*train)(prefetcher* pf, cache_t* c, uint64_t pc, uint64_t addr, int trigger);
+} pf_ops;
+
+static const pf_ops pf_table[NUM_PF] = {
+    [PF_NONE]     = { NULL },
+    [PF_NEXTLINE] = { pf_nextline },
+    [PF_STRIDE]   = { pf_stride },
+    [PF_STREAM]   = { pf_stream },
+    [PF_FDP]      = { pf_fdp },
+};
+
+prefetcher* prefetch_new(int kind, int degree) {
+    if (kind == PF_NONE) {
+        return NULL;
+    }
+    prefetcher* pf = calloc(1, sizeof(prefetcher));
+    pf->kind = kind;
+    pf->degree = degree;
+    for (int i = 0; i < PF_TRACK; i++) {
+        pf->track[i].line = PF_LINE_NONE;
+    }
+    return pf;
+}
+
+void prefetch_free(prefetcher* pf) {
+    free(pf);
+}
+
+void prefetch_access(prefetcher* pf, cache_t* c, uint64_t pc, uint64_t addr, int hit) {
+    uint64_t line = addr >> c->b;
+    int trigger = !hit;
+    if (!hit) {
+        pf->misses++;
+    }
+    for (int i = 0; i < PF_TRACK; i++) {
+        if (pf->track[i].line != line) {
+            continue;
+        }
+        // a miss here means the line was evicted before it was used
+        if (hit) {
+            pf->useful++;
+            if (pf->track[i].ready > stat_cycles) {
+                pf->late++;
+                c->last_latency += pf->track[i].ready - stat_cycles;
+            }
+            trigger = 1;
+        }
+        pf->track[i].line = PF_LINE_NONE;
+        break;
+    }
+    // the fills below must not disturb the demand access's latency
+    int latency = c->last_latency;
+    pf_demand = line;
+    pf_table[pf->kind].train(pf, c, pc, addr, trigger);
+    pf_demand = PF_LINE_NONE;
+    c->last_latency = latency;
+}
+
+void prefetch_issue(prefetcher* pf, cache_t* c, uint64_t addr) {
+    pf_issue(pf, c, addr >> c->b);
+}
+
+void prefetch_stats(const char* name, const prefetcher* pf) {
+    if (pf == NULL) {
+        return;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "%s prefetch (%s)", name, pf_names[pf->kind]);
+    printf("%-24s: %u issued, %u useful, %u late\n", label, pf->issued, pf->useful, pf->late);
+    // coverage: share of would-be misses that prefetching removed
+    printf("%-24s: accuracy %.1f%%, coverage %.1f%%\n", "",
+           pf->issued ? 100.0 * pf->useful / pf->issued : 0.0,
+           pf->useful + pf->misses ? 100.0 * pf->useful / (pf->useful + pf->misses) : 0.0);
+}
+
+// The prefetcher holds no pointers, so it is stored raw after its kind.
+int prefetch_save(FILE* f, const prefetcher* pf) {
+    int32_t kind = pf != NULL ? pf->kind : PF_NONE;
+    int err = ckpt_write(f, &kind, sizeof(kind));
+    if (pf != NULL) {
+        err |= ckpt_write(f, pf, sizeof(prefetcher));
+    }
+    return err;
+}
+
+prefetcher* prefetch_load(FILE* f, prefetcher* pf, int* err) {
+    int32_t kind;
+    if (ckpt_read(f, &kind, sizeof(kind)) < 0 || kind < 0 || kind >= NUM_PF) {
+        *err = -1;
+        return pf;
+    }
+    if (kind == PF_NONE) {
+        prefetch_free(pf);
+        return NULL;
+    }
+    if (pf == NULL) {
+        pf = prefetch_new(kind, 1);
+    }
+    *err |= ckpt_read(f, pf, sizeof(prefetcher));
+    if (pf->kind != kind || pf->degree < 1 || pf->degree > PF_MAX_DEGREE ||
+            pf->track_next < 0 || pf->track_next >= PF_TRACK) {
+        *err = -1;
+    }
+    return pf;
+}
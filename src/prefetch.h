@@ -0,0 +1,90 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Hardware prefetchers for the L1 caches. The pipeline reports every
+ * demand lookup to the cache's prefetcher, which trains on it and may
+ * fill further lines. A prefetched line is installed at once but is
+ * only usable `ready` cycles later; a demand hit before then pays the
+ * difference and counts as late.
+ */
+
+#ifndef _PREFETCH_H_
+#define _PREFETCH_H_
+
+#include "cache.h"
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    PF_NONE,
+    PF_NEXTLINE, // on a miss, fetch the next `degree` lines
+    PF_STRIDE,   // per-PC reference prediction table
+    PF_STREAM,   // follow ascending or descending runs of misses
+    PF_FDP,      // iCache only: lines of PCs in the fetch target queue
+    NUM_PF
+} pf_kind;
+
+extern const char* const pf_names[NUM_PF + 1];
+
+#define PF_TRACK   64 // prefetched lines not yet used
+#define PF_RPT     64 // stride table entries, indexed by PC
+#define PF_STREAMS 8
+#define PF_MAX_DEGREE 16
+
+typedef struct {
+    uint64_t line; // block number; PF_LINE_NONE when empty
+    uint64_t ready; // cycle the fill completes
+} pf_track_t;
+
+typedef struct {
+    uint64_t pc;
+    uint64_t last; // address of the previous access from pc
+    int64_t stride;
+    int conf; // 0..3, prefetches at 2 and above
+} pf_rpt_t;
+
+typedef struct {
+    uint64_t last; // block number of the latest trigger
+    int dir; // +1, -1, or 0 until a second trigger confirms it
+    uint32_t used; // clock value at last use, for replacement
+} pf_stream_t;
+
+typedef struct {
+    pf_kind kind;
+    int degree; // lines fetched per trigger
+    pf_track_t track[PF_TRACK];
+    int track_next; // ring position of the next tracked prefetch
+    pf_rpt_t rpt[PF_RPT];
+    pf_stream_t stream[PF_STREAMS];
+    uint32_t clock;
+    // issued: lines filled; useful: demand hits on them; late: useful
+    // hits that still had to wait; misses: demand misses
+    uint32_t issued, useful, late, misses;
+} prefetcher;
+
+extern prefetcher* iPrefetch;
+extern prefetcher* dPrefetch;
+
+/* NULL for PF_NONE */
+prefetcher* prefetch_new(int kind, int degree);
+void prefetch_free(prefetcher* pf);
+
+/* report a demand lookup of addr by the instruction at pc that
+   cache_update just made; a late prefetch raises c->last_latency.
+   Fills skip the set of addr, so the way cache_update returned still
+   holds it afterwards */
+void prefetch_access(prefetcher* pf, cache_t* c, uint64_t pc, uint64_t addr, int hit);
+
+/* prefetch the line holding addr on behalf of something other than
+   the prefetcher's own training */
+void prefetch_issue(prefetcher* pf, cache_t* c, uint64_t addr);
+
+void prefetch_stats(const char* name, const prefetcher* pf);
+
+/* checkpoint hooks, same contract as cache_save/cache_load */
+int prefetch_save(FILE* f, const prefetcher* pf);
+prefetcher* prefetch_load(FILE* f, prefetcher* pf, int* err);
+
+#endif
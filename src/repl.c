@@ -0,0 +1,224 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "repl.h"
+#include "checkpoint.h"
+#include <stdlib.h>
+
+#define RRPV_MAX 3
+#define BRRIP_NEAR 32 // BRRIP inserts at RRPV_MAX-1 once every this many fills
+
+const char* const repl_names[NUM_REPL + 1] = {
+    "fifo", "lru", "plru", "srrip", "brrip", "random", NULL
+};
+
+static uint32_t repl_rand(repl_t* r) {
+    // xorshift32
+    r->rng ^= r->rng << 13;
+    r->rng ^= r->rng >> 17;
+    r->rng ^= r->rng << 5;
+    return r->rng;
+}
+
+void repl_init(repl_t* r, repl_policy policy, int sets, int ways) {
+    r->policy = policy;
+    r->sets = sets;
+    r->ways = ways;
+    r->valid = calloc(sets, sizeof(uint64_t));
+    r->next = malloc(sets * ways);
+    r->prev = malloc(sets * ways);
+    r->head = malloc(sets);
+    r->tail = malloc(sets);
+    r->tree = calloc(sets, sizeof(uint64_t));
+    r->rrpv = malloc(sets * ways);
+    r->rng = 2463534242u;
+    // Lists start ordered way ways-1 (head) ... way 0 (tail), so a cold
+    // set fills way 0 first like the original clock scan did.
+    for (int s = 0; s < sets; s++) {
+        uint8_t* next = r->next + s * ways;
+        uint8_t* prev = r->prev + s * ways;
+        for (int w = 0; w < ways; w++) {
+            next[w] = w - 1;
+            prev[w] = w + 1;
+            r->rrpv[s * ways + w] = RRPV_MAX;
+        }
+        r->head[s] = ways - 1;
+        r->tail[s] = 0;
+    }
+}
+
+void repl_free(repl_t* r) {
+    free(r->valid);
+    free(r->next);
+    free(r->prev);
+    free(r->head);
+    free(r->tail);
+    free(r->tree);
+    free(r->rrpv);
+}
+
+static void list_unlink(repl_t* r, int set, int way) {
+    uint8_t* next = r->next + set * r->ways;
+    uint8_t* prev = r->prev + set * r->ways;
+    if (r->head[set] == way) {
+        r->head[set] = next[way];
+    } else {
+        next[prev[way]] = next[way];
+    }
+    if (r->tail[set] == way) {
+        r->tail[set] = prev[way];
+    } else {
+        prev[next[way]] = prev[way];
+    }
+}
+
+static void list_push_front(repl_t* r, int set, int way) {
+    if (r->ways == 1 || r->head[set] == way) {
+        return;
+    }
+    list_unlink(r, set, way);
+    r->next[set * r->ways + way] = r->head[set];
+    r->prev[set * r->ways + r->head[set]] = way;
+    r->head[set] = way;
+}
+
+static void list_push_back(repl_t* r, int set, int way) {
+    if (r->ways == 1 || r->tail[set] == way) {
+        return;
+    }
+    list_unlink(r, set, way);
+    r->prev[set * r->ways + way] = r->tail[set];
+    r->next[set * r->ways + r->tail[set]] = way;
+    r->tail[set] = way;
+}
+
+// Tree PLRU: node n has children 2n+1 and 2n+2, leaves are the ways.
+// A node bit of 1 means the victim lies in its right subtree.
+static void plru_touch(repl_t* r, int set, int way) {
+    int node = 0;
+    for (int span = r->ways; span > 1; span >>= 1) {
+        int right = (way & (span / 2)) != 0;
+        if (right) {
+            r->tree[set] &= ~(1ULL << node);
+        } else {
+            r->tree[set] |= 1ULL << node;
+        }
+        node = 2 * node + 1 + right;
+    }
+}
+
+static int plru_victim(repl_t* r, int set) {
+    int node = 0, way = 0;
+    for (int span = r->ways; span > 1; span >>= 1) {
+        int right = (r->tree[set] >> node) & 1;
+        way |= right ? span / 2 : 0;
+        node = 2 * node + 1 + right;
+    }
+    return way;
+}
+
+void repl_hit(repl_t* r, int set, int way) {
+    switch (r->policy) {
+        case REPL_LRU:
+            list_push_front(r, set, way);
+            break;
+        case REPL_PLRU:
+            plru_touch(r, set, way);
+            break;
+        case REPL_SRRIP:
+        case REPL_BRRIP:
+            r->rrpv[set * r->ways + way] = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void repl_fill(repl_t* r, int set, int way) {
+    r->valid[set] |= 1ULL << way;
+    switch (r->policy) {
+        case REPL_FIFO:
+        case REPL_LRU:
+            list_push_front(r, set, way);
+            break;
+        case REPL_PLRU:
+            plru_touch(r, set, way);
+            break;
+        case REPL_SRRIP:
+            r->rrpv[set * r->ways + way] = RRPV_MAX - 1;
+            break;
+        case REPL_BRRIP:
+            r->rrpv[set * r->ways + way] =
+                repl_rand(r) % BRRIP_NEAR == 0 ? RRPV_MAX - 1 : RRPV_MAX;
+            break;
+        default:
+            break;
+    }
+}
+
+void repl_invalidate(repl_t* r, int set, int way) {
+    r->valid[set] &= ~(1ULL << way);
+    if (r->policy == REPL_FIFO || r->policy == REPL_LRU) {
+        list_push_back(r, set, way);
+    }
+    r->rrpv[set * r->ways + way] = RRPV_MAX;
+}
+
+int repl_victim(repl_t* r, int set) {
+    uint64_t full = r->ways == 64 ? ~0ULL : (1ULL << r->ways) - 1;
+    if (r->valid[set] != full) {
+        return __builtin_ctzll(~r->valid[set] & full);
+    }
+    switch (r->policy) {
+        case REPL_FIFO:
+        case REPL_LRU:
+            return r->tail[set];
+        case REPL_PLRU:
+            return plru_victim(r, set);
+        case REPL_SRRIP:
+        case REPL_BRRIP: {
+            uint8_t* rrpv = r->rrpv + set * r->ways;
+            for (;;) {
+                for (int w = 0; w < r->ways; w++) {
+                    if (rrpv[w] == RRPV_MAX) {
+                        return w;
+                    }
+                }
+                for (int w = 0; w < r->ways; w++) {
+                    rrpv[w]++;
+                }
+            }
+        }
+        default:
+            return repl_rand(r) % r->ways;
+    }
+}
+
+int repl_save(FILE* f, repl_t* r) {
+    int n = r->sets * r->ways;
+    int err = ckpt_write(f, r->valid, r->sets * sizeof(uint64_t));
+    err |= ckpt_write(f, r->next, n);
+    err |= ckpt_write(f, r->prev, n);
+    err |= ckpt_write(f, r->head, r->sets);
+    err |= ckpt_write(f, r->tail, r->sets);
+    err |= ckpt_write(f, r->tree, r->sets * sizeof(uint64_t));
+    err |= ckpt_write(f, r->rrpv, n);
+    err |= ckpt_write(f, &r->rng, sizeof(r->rng));
+    return err;
+}
+
+int repl_load(FILE* f, repl_t* r) {
+    int n = r->sets * r->ways;
+    int err = ckpt_read(f, r->valid, r->sets * sizeof(uint64_t));
+    err |= ckpt_read(f, r->next, n);
+    err |= ckpt_read(f, r->prev, n);
+    err |= ckpt_read(f, r->head, r->sets);
+    err |= ckpt_read(f, r->tail, r->sets);
+    err |= ckpt_read(f, r->tree, r->sets * sizeof(uint64_t));
+    err |= ckpt_read(f, r->rrpv, n);
+    err |= ckpt_read(f, &r->rng, sizeof(r->rng));
+    return err;
+}
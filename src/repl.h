@@ -0,0 +1,56 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Cache replacement policies. A cache keeps one repl_t and reports
+ * hits, fills and invalidations to it; repl_victim picks the way to
+ * evict. Invalid ways are always used first. Every operation is O(1)
+ * except the SRRIP/BRRIP aging pass.
+ */
+
+#ifndef _REPL_H_
+#define _REPL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    REPL_FIFO,   // evict the oldest fill; hits do not count
+    REPL_LRU,    // true LRU, move-to-front list per set
+    REPL_PLRU,   // tree pseudo-LRU (power-of-two ways)
+    REPL_SRRIP,  // static re-reference interval prediction, 2-bit
+    REPL_BRRIP,  // bimodal RRIP: most fills predicted distant
+    REPL_RANDOM,
+    NUM_REPL
+} repl_policy;
+
+#define REPL_MAX_WAYS 64
+
+extern const char* const repl_names[NUM_REPL + 1];
+
+typedef struct {
+    repl_policy policy;
+    int sets, ways;
+    uint64_t* valid; // per set: bit w set when way w holds a line
+    uint8_t* next;   // FIFO/LRU: per way, the way behind it in the list
+    uint8_t* prev;   // FIFO/LRU: per way, the way ahead of it
+    uint8_t* head;   // FIFO/LRU: per set, most recent way
+    uint8_t* tail;   // FIFO/LRU: per set, next victim
+    uint64_t* tree;  // PLRU: per set, ways-1 node bits
+    uint8_t* rrpv;   // SRRIP/BRRIP: per way, 0..3
+    uint32_t rng;    // RANDOM and BRRIP's bimodal throttle
+} repl_t;
+
+void repl_init(repl_t* r, repl_policy policy, int sets, int ways);
+void repl_free(repl_t* r);
+void repl_hit(repl_t* r, int set, int way);
+void repl_fill(repl_t* r, int set, int way);
+void repl_invalidate(repl_t* r, int set, int way);
+int repl_victim(repl_t* r, int set);
+
+/* checkpoint hooks; the policy and geometry must already match */
+int repl_save(FILE* f, repl_t* r);
+int repl_load(FILE* f, repl_t* r);
+
+#endif
@@ -17,9 +17,24 @@
 #include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "shell.h"
 #include "pipe.h"
+#include "bp.h"
+#include "trace.h"
+#include "fastfwd.h"
+#include "checkpoint.h"
+#include "mem.h"
+#include "cache.h"
+#include "config.h"
+#include "prefetch.h"
+#include "storebuf.h"
+#include "ftq.h"
+#include "ooo.h"
+#include "fu.h"
 
 /***************************************************************/
 /* Statistics.                                                 */
@@ -28,82 +43,6 @@
 uint32_t stat_cycles = 0, stat_inst_retire = 0, stat_inst_fetch = 0;
 uint32_t stat_squash = 0;
 
-/***************************************************************/
-/* Main memory.                                                */
-/***************************************************************/
-
-#define MEM_DATA_START  0x10000000
-#define MEM_DATA_SIZE   0x00100000
-#define MEM_TEXT_START  0x00400000
-#define MEM_TEXT_SIZE   0x00100000
-#define MEM_STACK_START 0xfffffffc
-#define MEM_STACK_SIZE  0x00100000
-
-typedef struct {
-    uint64_t start, size;
-    uint8_t *mem;
-} mem_region_t;
-
-/* memory will be dynamically allocated at initialization */
-mem_region_t MEM_REGIONS[] = {
-    { MEM_TEXT_START, MEM_TEXT_SIZE, NULL },
-    { MEM_DATA_START, MEM_DATA_SIZE, NULL },
-    { MEM_STACK_START, MEM_STACK_SIZE, NULL },
-};
-#define MEM_NREGIONS (sizeof(MEM_REGIONS)/sizeof(mem_region_t))
-
-
-
-/***************************************************************/
-/*                                                             */
-/* Procedure: mem_read_32                                      */
-/*                                                             */
-/* Purpose: Read a 32-bit word from memory                     */
-/*                                                             */
-/***************************************************************/
-uint32_t mem_read_32(uint64_t address)
-{
-    int i;
-    for (i = 0; i < MEM_NREGIONS; i++) {
-        if (address >= MEM_REGIONS[i].start &&
-                address < (MEM_REGIONS[i].start + MEM_REGIONS[i].size)) {
-            uint32_t offset = address - MEM_REGIONS[i].start;
-
-            return
-                (MEM_REGIONS[i].mem[offset+3] << 24) |
-                (MEM_REGIONS[i].mem[offset+2] << 16) |
-                (MEM_REGIONS[i].mem[offset+1] <<  8) |
-                (MEM_REGIONS[i].mem[offset+0] <<  0);
-        }
-    }
-
-    return 0;
-}
-
-/***************************************************************/
-/*                                                             */
-/* Procedure: mem_write_32                                     */
-/*                                                             */
-/* Purpose: Write a 32-bit word to memory                      */
-/*                                                             */
-/***************************************************************/
-void mem_write_32(uint64_t address, uint32_t value)
-{
-    int i;
-    for (i = 0; i < MEM_NREGIONS; i++) {
-        if (address >= MEM_REGIONS[i].start &&
-                address < (MEM_REGIONS[i].start + MEM_REGIONS[i].size)) {
-            uint32_t offset = address - MEM_REGIONS[i].start;
-
-            MEM_REGIONS[i].mem[offset+3] = (value >> 24) & 0xFF;
-            MEM_REGIONS[i].mem[offset+2] = (value >> 16) & 0xFF;
-            MEM_REGIONS[i].mem[offset+1] = (value >>  8) & 0xFF;
-            MEM_REGIONS[i].mem[offset+0] = (value >>  0) & 0xFF;
-            return;
-        }
-    }
-}
-
 /***************************************************************/
 /*                                                             */
 /* Procedure : help                                            */
@@ -115,9 +54,17 @@ void help() {
   printf("----------------ARM ISIM Help-----------------------\n");
   printf("go                     -  run program to completion         \n");
   printf("run n                  -  execute program for n instructions\n");
+  printf("fastforward n [warm]   -  execute n instructions functionally,\n");
+  printf("                          warming caches/bp on the last warm\n");
   printf("mdump low high         -  dump memory from low to high      \n");
   printf("rdump                  -  dump the register & bus values    \n");
   printf("input reg_no reg_value - set GPR reg_no to reg_value  \n");
+  printf("stats                  -  print simulator statistics        \n");
+  printf("trace mask [level]     -  select trace categories (hex mask)\n");
+  printf("btrace file | off      -  write a binary per-cycle trace    \n");
+  printf("checkpoint file        -  save the full simulator state     \n");
+  printf("config                 -  print the machine configuration   \n");
+  printf("restore file           -  resume from a saved checkpoint    \n");
   printf("?                      -  display this help menu            \n");
   printf("quit                   -  exit the program                  \n\n");
 }
@@ -130,7 +77,10 @@ void help() {
 /*                                                             */
 /***************************************************************/
 void cycle() {                                                
-  pipe_cycle();
+  if (config.core == CORE_OOO)
+    ooo_cycle();
+  else
+    pipe_cycle();
 
   stat_cycles++;
 }
@@ -160,6 +110,26 @@ void run(int num_cycles) {
   }
 }
 
+/***************************************************************/
+/*                                                             */
+/* Procedure : fast_forward                                    */
+/*                                                             */
+/* Purpose   : Execute n instructions without timing, then     */
+/*             resume the pipeline from the next instruction   */
+/*                                                             */
+/***************************************************************/
+void fast_forward(uint64_t n, uint64_t warm) {
+  if (!RUN_BIT) {
+    printf("Can't simulate, Simulator is halted\n\n");
+    return;
+  }
+
+  uint64_t done = fastforward(n, warm);
+  printf("Fast-forwarded %" PRIu64 " instructions, PC = 0x%" PRIx64 "\n\n", done, CURRENT_STATE.PC);
+  if (!RUN_BIT)
+    printf("Simulator halted\n\n");
+}
+
 /***************************************************************/
 /*                                                             */
 /* Procedure : go                                              */
@@ -186,20 +156,28 @@ void go() {
 /*             output file.                                    */
 /*                                                             */
 /***************************************************************/
+/* dirty dCache lines are newer than memory, so read through it */
+static uint32_t mdump_read_32(uint64_t address) {
+  uint32_t word;
+  cache_read(dCache, address, &word, 4);
+  sb_forward(address, &word, 4);
+  return word;
+}
+
 void mdump(FILE * dumpsim_file, int start, int stop) {          
   int address;
 
   printf("\nMemory content [0x%08x..0x%08x] :\n", start, stop);
   printf("-------------------------------------\n");
   for (address = start; address <= stop; address += 4)
-    printf("  0x%08x (%d) : 0x%x\n", address, address, mem_read_32(address));
+    printf("  0x%08x (%d) : 0x%x\n", address, address, mdump_read_32(address));
   printf("\n");
 
   /* dump the memory contents into the dumpsim file */
   fprintf(dumpsim_file, "\nMemory content [0x%08x..0x%08x] :\n", start, stop);
   fprintf(dumpsim_file, "-------------------------------------\n");
   for (address = start; address <= stop; address += 4)
-    fprintf(dumpsim_file, "  0x%08x (%d) : 0x%x\n", address, address, mem_read_32(address));
+    fprintf(dumpsim_file, "  0x%08x (%d) : 0x%x\n", address, address, mdump_read_32(address));
   fprintf(dumpsim_file, "\n");
 }
 
@@ -240,6 +218,76 @@ void rdump(FILE * dumpsim_file) {
   fprintf(dumpsim_file, "\n");
 }
 
+/***************************************************************/
+/*                                                             */
+/* Procedure : stats                                           */
+/*                                                             */
+/* Purpose   : Print simulator statistics                      */
+/*                                                             */
+/***************************************************************/
+void stats() {
+  printf("\nSimulator statistics :\n");
+  printf("-------------------------------------\n");
+  printf("Cycles                  : %u\n", stat_cycles);
+  printf("Instructions Retired    : %u\n", stat_inst_retire);
+  if (config.width > 1)
+    printf("IPC (width %d)           : %.3f\n", config.width,
+           stat_cycles ? (double)stat_inst_retire / stat_cycles : 0.0);
+  printf("Fast-forwarded          : %u\n", stat_inst_ff);
+  printf("Instruction allocations : %u\n", stat_inst_alloc);
+  printf("Memory pages touched    : %" PRIu64 "\n", mem_pages_touched());
+  printf("dCache writebacks       : %u\n", dCache->writebacks);
+  if (l2Cache != NULL)
+    printf("L2 writebacks           : %u\n", l2Cache->writebacks);
+  printf("Cond. branches          : %u, %u mispredicted (%s)\n", stat_br_cond, stat_br_dir_miss,
+         bp_dir_names[bp->dir->kind]);
+  printf("Returns                 : %u, %u mispredicted\n", stat_br_ret, stat_br_ret_miss);
+  prefetch_stats("iCache", iPrefetch);
+  prefetch_stats("dCache", dPrefetch);
+  if (config.sb_entries > 0) {
+    printf("Stores buffered         : %u\n", stat_sb_stores);
+    printf("Loads forwarded         : %u\n", stat_sb_forwards);
+    printf("SB full stall cycles    : %u\n", stat_sb_full);
+  }
+  if (config.ftq_entries > 0)
+    printf("FTQ empty cycles        : %u\n", stat_ftq_empty);
+  if (config.mshrs > 0) {
+    printf("MSHR merged misses      : %u\n", stat_mshr_merge);
+    printf("MSHR full stall cycles  : %u\n", stat_mshr_full);
+    printf("Load wait cycles        : %u\n", stat_reg_wait);
+  }
+  if (fu_modelled()) {
+    printf("FU busy cycles          : %u\n", stat_fu_busy);
+    if (config.core == CORE_INORDER)
+      printf("FU result wait cycles   : %u\n", stat_fu_wait);
+  }
+  if (config.core == CORE_OOO) {
+    printf("ROB/IQ/LSQ full cycles  : %u, %u, %u\n", stat_ooo_rob_full, stat_ooo_iq_full,
+           stat_ooo_lsq_full);
+    printf("Free list empty cycles  : %u\n", stat_ooo_prf_full);
+    printf("Load ordering waits     : %u\n", stat_ooo_load_wait);
+    printf("Squashed instructions   : %u\n", stat_ooo_squash);
+  }
+  printf("\n");
+}
+
+/***************************************************************/
+/*                                                             */
+/* Procedure : trace                                           */
+/*                                                             */
+/* Purpose   : Select which trace categories are printed       */
+/*                                                             */
+/***************************************************************/
+void trace(uint32_t mask, int level) {
+  if (SIM_TRACE == 0) {
+    printf("Tracing is compiled out; build with 'make sim-trace'\n\n");
+    return;
+  }
+  trace_mask = mask;
+  trace_level = level;
+  printf("Trace mask 0x%x, level %d\n\n", trace_mask, trace_level);
+}
+
 /***************************************************************/
 /*                                                             */
 /* Procedure : get_command                                     */
@@ -252,6 +300,10 @@ void get_command(FILE * dumpsim_file) {
   int start, stop, cycles;
   int register_no;
   int64_t register_value;
+  uint32_t mask;
+  int level;
+  char filename[256];
+  uint64_t count, warm;
 
   printf("ARM-SIM> ");
 
@@ -287,16 +339,82 @@ void get_command(FILE * dumpsim_file) {
   case 'r':
     if (buffer[1] == 'd' || buffer[1] == 'D')
 	    rdump(dumpsim_file);
+    else if (buffer[1] == 'e' || buffer[1] == 'E') {
+	    if (scanf("%255s", filename) != 1) break;
+	    if (checkpoint_restore(filename) < 0)
+	        printf("Error: Can't restore checkpoint %s\n\n", filename);
+	    else
+	        printf("Restored checkpoint %s, cycle %u\n\n", filename, stat_cycles);
+    }
     else {
 	    if (scanf("%d", &cycles) != 1) break;
 	    run(cycles);
     }
     break;
 
+  case 'S':
+  case 's':
+    stats();
+    break;
+
+  case 'T':
+  case 't':
+    if (scanf("%x", &mask) != 1)
+        break;
+    level = SIM_TRACE;
+    if (scanf("%*[ \t]%d", &level) != 1)
+        level = SIM_TRACE;
+    trace(mask, level);
+    break;
+
+  case 'F':
+  case 'f':
+    if (scanf("%" SCNu64, &count) != 1)
+        break;
+    warm = count;
+    if (scanf("%*[ \t]%" SCNu64, &warm) != 1)
+        warm = count;
+    fast_forward(count, warm);
+    break;
+
+  case 'C':
+  case 'c':
+    if (buffer[1] == 'o' || buffer[1] == 'O') {
+        config_print();
+        break;
+    }
+    if (scanf("%255s", filename) != 1)
+        break;
+    if (checkpoint_save(filename) < 0)
+        printf("Error: Can't write checkpoint %s\n\n", filename);
+    else
+        printf("Wrote checkpoint %s, cycle %u\n\n", filename, stat_cycles);
+    break;
+
+  case 'B':
+  case 'b':
+    if (scanf("%255s", filename) != 1)
+        break;
+    if (strcmp(filename, "off") == 0) {
+        btrace_close();
+        printf("Binary trace closed\n\n");
+    } else if (btrace_unsupported() != NULL) {
+        printf("Error: binary trace needs the scalar in-order pipe; %s\n\n", btrace_unsupported());
+    } else if (btrace_open(filename) < 0) {
+        printf("Error: Can't open trace file %s\n\n", filename);
+    } else {
+        printf("Writing binary trace to %s\n\n", filename);
+    }
+    break;
+
   case 'I':
   case 'i':
    if (scanf("%i %" PRIx64, &register_no, &register_value) != 2)
       break;
+   // Instructions in flight may already hold the old value (the OOO
+   // core in a physical register), so run them again from the oldest
+   // unretired one, as fast-forward does
+   CURRENT_STATE.PC = pipe_squash();
    CURRENT_STATE.REGS[register_no] = register_value;
    break;
 
@@ -306,19 +424,40 @@ void get_command(FILE * dumpsim_file) {
   }
 }
 
-/***************************************************************/
-/*                                                             */
-/* Procedure : init_memory                                     */
-/*                                                             */
-/* Purpose   : Allocate and zero memory                        */
-/*                                                             */
-/***************************************************************/
-void init_memory() {                                           
-    int i;
-    for (i = 0; i < MEM_NREGIONS; i++) {
-        MEM_REGIONS[i].mem = malloc(MEM_REGIONS[i].size);
-        memset(MEM_REGIONS[i].mem, 0, MEM_REGIONS[i].size);
-    }
+/**************************************************************/
+/*                                                            */
+/* Procedure : load_elf                                       */
+/*                                                            */
+/* Purpose   : Copy the PT_LOAD segments of a little-endian   */
+/*             AArch64 ELF64 image into memory and start at   */
+/*             its entry. Returns -2 for an ELF built for any */
+/*             other machine, -1 if the image is malformed.   */
+/*                                                            */
+/**************************************************************/
+static int load_elf(const uint8_t *image, size_t size) {
+  const Elf64_Ehdr *eh = (const Elf64_Ehdr *)image;
+  int i;
+
+  if (size < sizeof(Elf64_Ehdr))
+    return -1;
+  if (eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_ident[EI_DATA] != ELFDATA2LSB ||
+      eh->e_machine != EM_AARCH64)
+    return -2;
+  if (eh->e_phentsize != sizeof(Elf64_Phdr) ||
+      eh->e_phoff > size || (size - eh->e_phoff) / sizeof(Elf64_Phdr) < eh->e_phnum)
+    return -1;
+
+  for (i = 0; i < eh->e_phnum; i++) {
+    const Elf64_Phdr *ph = (const Elf64_Phdr *)(image + eh->e_phoff) + i;
+    if (ph->p_type != PT_LOAD || ph->p_filesz == 0)
+      continue;
+    if (ph->p_offset > size || size - ph->p_offset < ph->p_filesz ||
+        mem_write_block(ph->p_vaddr, image + ph->p_offset, ph->p_filesz) < 0)
+      return -1;
+  }
+
+  CURRENT_STATE.PC = eh->e_entry;
+  return 0;
 }
 
 /**************************************************************/
@@ -326,33 +465,78 @@ void init_memory() {
 /* Procedure : load_program                                   */
 /*                                                            */
 /* Purpose   : Load program and service routines into mem.    */
+/*             ELF images and raw .bin images are mmap'd and  */
+/*             copied in whole; anything else is read as the  */
+/*             original one-hex-word-per-line .x format.      */
 /*                                                            */
 /**************************************************************/
 void load_program(char *program_filename) {                   
   FILE * prog;
-  int ii, word;
+  int ii, word, err;
+  struct stat st;
+  size_t len = strlen(program_filename);
+  int is_bin = len > 4 && strcmp(program_filename + len - 4, ".bin") == 0;
 
   /* Open program file. */
   prog = fopen(program_filename, "r");
-  if (prog == NULL) {
+  if (prog == NULL || fstat(fileno(prog), &st) < 0) {
     printf("Error: Can't open program file %s\n", program_filename);
     exit(-1);
   }
 
+  /* a raw image too short to hold ELFMAG is still binary, not hex */
+  if (st.st_size >= SELFMAG || (is_bin && st.st_size > 0)) {
+    uint8_t *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(prog), 0);
+    if (image == MAP_FAILED) {
+      printf("Error: Can't map program file %s\n", program_filename);
+      exit(-1);
+    }
+
+    if (st.st_size >= SELFMAG && memcmp(image, ELFMAG, SELFMAG) == 0) {
+      err = load_elf(image, st.st_size);
+      if (err == -2) {
+        printf("Error: ELF file %s is not a little-endian AArch64 image\n", program_filename);
+        exit(-1);
+      }
+      if (err < 0) {
+        printf("Error: Malformed or unloadable ELF file %s\n", program_filename);
+        exit(-1);
+      }
+      printf("Loaded ELF image %s, entry 0x%" PRIx64 ".\n\n", program_filename, CURRENT_STATE.PC);
+      munmap(image, st.st_size);
+      fclose(prog);
+      return;
+    }
+
+    if (is_bin) {
+      if (mem_write_block(MEM_REGIONS[MEM_TEXT].start, image, st.st_size) < 0) {
+        printf("Error: Program file %s does not fit in memory\n", program_filename);
+        exit(-1);
+      }
+      CURRENT_STATE.PC = MEM_REGIONS[MEM_TEXT].start;
+      printf("Read %d words from program into memory.\n\n", (int)(st.st_size / 4));
+      munmap(image, st.st_size);
+      fclose(prog);
+      return;
+    }
+    munmap(image, st.st_size);
+  }
+
   /* Read in the program. */
 
   ii = 0;
   int bytes_read = EOF;
   while ((bytes_read=fscanf(prog, "%x\n", &word)) > 0) {
-    mem_write_32(MEM_TEXT_START + ii, word);
+    mem_write_32(MEM_REGIONS[MEM_TEXT].start + ii, word);
     ii += 4;
   }
   if (bytes_read == 0) {
     printf("Error: Malformed program file %s\n", program_filename);
     exit(-1);
   }
+  fclose(prog);
 
-  CURRENT_STATE.PC = MEM_TEXT_START;
+  CURRENT_STATE.PC = MEM_REGIONS[MEM_TEXT].start;
 
   printf("Read %d words from program into memory.\n\n", ii/4);
 }
@@ -367,7 +551,10 @@ void load_program(char *program_filename) {
 void initialize(char *program_filename, int num_prog_files) { 
   int i;
 
-  init_memory();
+  if (init_memory() < 0) {
+    printf("Error: Memory regions are empty or overlap\n");
+    exit(-1);
+  }
   pipe_init();
   for ( i = 0; i < num_prog_files; i++ ) {
     load_program(program_filename);
@@ -384,17 +571,48 @@ void initialize(char *program_filename, int num_prog_files) {
 /***************************************************************/
 int main(int argc, char *argv[]) {                              
   FILE * dumpsim_file;
+  int arg = 1;
+  char name[MEM_NAMELEN];
+  uint64_t start, size;
+
+  /* Options, repeatable and applied in order:
+       -m name=start:size   memory region layout
+       -c file              configuration file
+       -o key=value         single configuration option */
+  while (arg + 1 < argc && argv[arg][0] == '-') {
+    if (strcmp(argv[arg], "-m") == 0) {
+      if (sscanf(argv[arg + 1], "%15[^=]=%" SCNi64 ":%" SCNi64, name, &start, &size) != 3 ||
+          mem_set_region(name, start, size) < 0) {
+        printf("Error: Bad memory region %s\n", argv[arg + 1]);
+        exit(1);
+      }
+    } else if (strcmp(argv[arg], "-c") == 0) {
+      if (config_load(argv[arg + 1]) < 0)
+        exit(1);
+    } else if (strcmp(argv[arg], "-o") == 0) {
+      if (config_set_pair(argv[arg + 1]) < 0) {
+        printf("Error: Bad option %s\n", argv[arg + 1]);
+        exit(1);
+      }
+    } else {
+      break;
+    }
+    arg += 2;
+  }
 
   /* Error Checking */
-  if (argc < 2) {
-    printf("Error: usage: %s <program_file_1> <program_file_2> ...\n",
+  if (argc - arg < 1) {
+    printf("Error: usage: %s [-m name=start:size] [-c config] [-o key=value] <program_file_1> <program_file_2> ...\n",
            argv[0]);
     exit(1);
   }
+  if (config_validate() < 0)
+    exit(1);
 
   printf("ARM Simulator\n\n");
 
-  initialize(argv[1], argc - 1);
+  initialize(argv[arg], argc - arg);
+  atexit(btrace_close);
 
   if ( (dumpsim_file = fopen( "dumpsim", "w" )) == NULL ) {
     printf("Error: Can't open dumpsim file\n");
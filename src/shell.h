@@ -23,6 +23,9 @@
 /* only the cache touches these functions */
 uint32_t mem_read_32(uint64_t address);
 void     mem_write_32(uint64_t address, uint32_t value);
+uint64_t mem_read_64(uint64_t address);
+void     mem_write_64(uint64_t address, uint64_t value);
+void     mem_read_block(uint64_t address, void *dst, uint32_t n);
 
 /* statistics */
 extern uint32_t stat_cycles, stat_inst_retire, stat_inst_fetch, stat_squash;
@@ -0,0 +1,166 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "storebuf.h"
+#include "shell.h"
+#include "cache.h"
+#include "config.h"
+#include "prefetch.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include <string.h>
+
+// Circular queue of config.sb_entries slots, oldest at head. Only the
+// head drains: `draining` is set once its dCache access has started,
+// and it is written and popped at `ready`.
+static struct {
+    sb_entry e[SB_MAX_ENTRIES];
+    int head, count;
+    bool draining;
+    uint64_t ready;
+} sb;
+
+uint32_t stat_sb_stores = 0, stat_sb_forwards = 0, stat_sb_full = 0;
+
+static inline sb_entry* sb_at(int i) {
+    return &sb.e[(sb.head + i) % config.sb_entries];
+}
+
+void sb_reset() {
+    sb.head = 0;
+    sb.count = 0;
+    sb.draining = false;
+    sb.ready = 0;
+}
+
+int sb_count() {
+    return sb.count;
+}
+
+bool sb_full() {
+    return sb.count == config.sb_entries;
+}
+
+int sb_wait() {
+    if (sb.draining && sb.ready > stat_cycles) {
+        return sb.ready - stat_cycles;
+    }
+    return 1;
+}
+
+void sb_push(uint64_t pc, uint64_t addr, const void* data, int size) {
+    sb_entry* e = sb_at(sb.count);
+    e->pc = pc;
+    e->addr = addr;
+    e->size = size;
+    memcpy(e->data, data, size);
+    sb.count++;
+    stat_sb_stores++;
+}
+
+int sb_lookup(uint64_t addr, int n) {
+    uint32_t covered = 0;
+    uint32_t all = (1u << n) - 1;
+    for (int i = 0; i < sb.count; i++) {
+        sb_entry* e = sb_at(i);
+        for (int j = 0; j < e->size; j++) {
+            uint64_t off = e->addr + j - addr;
+            if (off < n) {
+                covered |= 1u << off;
+            }
+        }
+    }
+    return covered == 0 ? SB_NONE : covered == all ? SB_ALL : SB_SOME;
+}
+
+void sb_forward(uint64_t addr, void* buf, int n) {
+    uint8_t* out = buf;
+    for (int i = 0; i < sb.count; i++) {
+        sb_entry* e = sb_at(i);
+        for (int j = 0; j < e->size; j++) {
+            uint64_t off = e->addr + j - addr;
+            if (off < n) {
+                out[off] = e->data[j];
+            }
+        }
+    }
+}
+
+static void sb_pop() {
+    sb_entry* e = sb_at(0);
+    cache_write(dCache, e->addr, e->data, e->size);
+    sb.head = (sb.head + 1) % config.sb_entries;
+    sb.count--;
+    sb.draining = false;
+}
+
+// Start the head's dCache access if it has not begun, and write and
+// pop it once that access is done, so at most one store leaves per
+// cycle and a hit leaves in the cycle it starts. The access allocates
+// like a demand store (write-allocate) and charges the same latency.
+void sb_drain() {
+    if (sb.count == 0) {
+        return;
+    }
+    sb_entry* e = sb_at(0);
+    if (!sb.draining) {
+        int line;
+        int hit = cache_update(dCache, e->addr, &line);
+        if (dPrefetch != NULL) {
+            prefetch_access(dPrefetch, dCache, e->pc, e->addr, hit);
+        }
+        sb.draining = true;
+        sb.ready = stat_cycles + dCache->last_latency;
+    }
+    if (sb.ready <= stat_cycles) {
+        TRACE(TRACE_DETAIL, TRACE_CACHE, "store drained: 0x%lx\n", e->addr);
+        sb_pop();
+    }
+}
+
+void sb_flush() {
+    while (sb.count > 0) {
+        sb_pop();
+    }
+}
+
+// Entries are stored oldest first, so the ring position is not saved.
+int sb_save(FILE* f) {
+    int err = ckpt_write(f, &sb.count, sizeof(sb.count));
+    err |= ckpt_write(f, &sb.draining, sizeof(sb.draining));
+    err |= ckpt_write(f, &sb.ready, sizeof(sb.ready));
+    for (int i = 0; i < sb.count; i++) {
+        err |= ckpt_write(f, sb_at(i), sizeof(sb_entry));
+    }
+    err |= ckpt_write(f, &stat_sb_stores, sizeof(stat_sb_stores));
+    err |= ckpt_write(f, &stat_sb_forwards, sizeof(stat_sb_forwards));
+    err |= ckpt_write(f, &stat_sb_full, sizeof(stat_sb_full));
+    return err;
+}
+
+int sb_load(FILE* f) {
+    sb_reset();
+    int err = ckpt_read(f, &sb.count, sizeof(sb.count));
+    if (err || sb.count < 0 || sb.count > config.sb_entries) {
+        sb.count = 0;
+        return -1;
+    }
+    err |= ckpt_read(f, &sb.draining, sizeof(sb.draining));
+    err |= ckpt_read(f, &sb.ready, sizeof(sb.ready));
+    for (int i = 0; i < sb.count; i++) {
+        err |= ckpt_read(f, &sb.e[i], sizeof(sb_entry));
+        if (sb.e[i].size < 0 || sb.e[i].size > 8) {
+            err = -1;
+        }
+    }
+    err |= ckpt_read(f, &stat_sb_stores, sizeof(stat_sb_stores));
+    err |= ckpt_read(f, &stat_sb_forwards, sizeof(stat_sb_forwards));
+    err |= ckpt_read(f, &stat_sb_full, sizeof(stat_sb_full));
+    if (err) {
+        sb_reset();
+    }
+    return err;
+}
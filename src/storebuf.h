@@ -0,0 +1,59 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Store buffer. With sb.entries > 0 a store leaves MEM as soon as it
+ * is queued here; the head entry drains into the dCache in the
+ * background, one store per cycle when it hits and after the fill
+ * when it misses. Loads see queued stores: data is overlaid on what
+ * the dCache returns, and a load the buffer covers completely skips
+ * the dCache access altogether.
+ */
+
+#ifndef _STOREBUF_H_
+#define _STOREBUF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct {
+    uint64_t pc; // of the store, for the dCache prefetcher
+    uint64_t addr;
+    int size; // bytes, at most 8
+    uint8_t data[8];
+} sb_entry;
+
+// How much of a load a lookup found in the buffer
+enum { SB_NONE, SB_SOME, SB_ALL };
+
+/* stores queued, loads served entirely from the buffer, cycles MEM
+   waited for a free entry */
+extern uint32_t stat_sb_stores, stat_sb_forwards, stat_sb_full;
+
+void sb_reset();
+int sb_count();
+bool sb_full();
+
+/* cycles until the head entry leaves; at least 1 */
+int sb_wait();
+
+void sb_push(uint64_t pc, uint64_t addr, const void* data, int size);
+
+/* SB_NONE, SB_SOME or SB_ALL for the n bytes at addr */
+int sb_lookup(uint64_t addr, int n);
+
+/* overlay queued store data, oldest first, on n bytes read at addr */
+void sb_forward(uint64_t addr, void* buf, int n);
+
+/* advance the drain by one cycle */
+void sb_drain();
+
+/* write every queued store to the dCache now */
+void sb_flush();
+
+int sb_save(FILE* f);
+int sb_load(FILE* f);
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ */
+
+#include "trace.h"
+#include "pipe.h"
+#include "shell.h"
+#include "config.h"
+#include "ooo.h"
+#include <string.h>
+
+uint32_t trace_mask = TRACE_ALL;
+int trace_level = SIM_TRACE;
+
+/* binary trace state */
+uint32_t btrace_events;
+static FILE* btrace_file = NULL;
+static btrace_rec btrace_ring[BTRACE_RING];
+static int btrace_count = 0;
+static btrace_rec btrace_cur;
+
+static void btrace_flush() {
+    if (btrace_count > 0) {
+        fwrite(btrace_ring, sizeof(btrace_rec), btrace_count, btrace_file);
+        btrace_count = 0;
+    }
+}
+
+const char* btrace_unsupported() {
+    if (config.core != CORE_INORDER) {
+        return "core.model is not inorder";
+    }
+    if (config.width > 1) {
+        return "pipe.width is above 1";
+    }
+    return NULL;
+}
+
+int btrace_open(const char* filename) {
+    btrace_close();
+    if (btrace_unsupported() != NULL) {
+        return -1;
+    }
+    btrace_file = fopen(filename, "wb");
+    if (btrace_file == NULL) {
+        return -1;
+    }
+    btrace_header hdr = { BTRACE_MAGIC, BTRACE_VERSION, sizeof(btrace_rec), NUM_OPCODES, 0 };
+    fwrite(&hdr, sizeof(hdr), 1, btrace_file);
+    for (int i = 0; i < NUM_OPCODES; i++) {
+        char name[BTRACE_NAMELEN] = { 0 };
+        strncpy(name, op_table[i].name, BTRACE_NAMELEN - 1);
+        fwrite(name, BTRACE_NAMELEN, 1, btrace_file);
+    }
+    return 0;
+}
+
+void btrace_close() {
+    if (btrace_file == NULL) {
+        return;
+    }
+    btrace_flush();
+    fclose(btrace_file);
+    btrace_file = NULL;
+}
+
+// Snapshot what each stage is about to work on this cycle.
+void btrace_begin_cycle() {
+    btrace_events = 0;
+    if (btrace_file == NULL) {
+        return;
+    }
+    // a restored checkpoint can bring its own core and width along
+    if (btrace_unsupported() != NULL) {
+        printf("Binary trace closed: %s\n", btrace_unsupported());
+        btrace_close();
+        return;
+    }
+    const instruction* in[TS_NSTAGES] = { NULL, pipe->IFtoDE, pipe->DEtoEX, pipe->EXtoMEM, pipe->MEMtoWB };
+    btrace_cur.cycle = stat_cycles;
+    btrace_cur.pc[TS_FETCH] = CURRENT_STATE.PC;
+    btrace_cur.op[TS_FETCH] = OP_NONE;
+    for (int s = TS_DE; s < TS_NSTAGES; s++) {
+        btrace_cur.pc[s] = in[s]->current_address;
+        btrace_cur.op[s] = in[s]->op;
+    }
+}
+
+void btrace_end_cycle() {
+    if (btrace_file == NULL) {
+        return;
+    }
+    btrace_cur.events = btrace_events;
+    btrace_ring[btrace_count++] = btrace_cur;
+    if (btrace_count == BTRACE_RING) {
+        btrace_flush();
+    }
+}
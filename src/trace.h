@@ -0,0 +1,117 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * Per-cycle trace output. A release build (make sim) compiles every
+ * TRACE() away. A trace build (make sim-trace) keeps messages up to
+ * level SIM_TRACE, filtered at runtime by trace_level and trace_mask.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef SIM_TRACE
+#define SIM_TRACE 0
+
+#endif
+
+// Levels: 1 = one line per stage per cycle, 2 = hazard / cache / branch detail
+#define TRACE_STAGE  1
+#define TRACE_DETAIL 2
+
+// Categories for trace_mask
+#define TRACE_CYCLE  0x001 // cycle header and stall counters
+#define TRACE_WB     0x002
+#define TRACE_MEM    0x004
+#define TRACE_EX     0x008
+#define TRACE_DE     0x010
+#define TRACE_FETCH  0x020
+#define TRACE_CACHE  0x040 // iCache / dCache lookups
+#define TRACE_HAZARD 0x080 // load-use stalls and forwarding
+#define TRACE_BRANCH 0x100 // branch resolution
+#define TRACE_ALL    0x1ff
+
+extern uint32_t trace_mask;
+extern int trace_level;
+
+#if SIM_TRACE > 0
+#define TRACE(lvl, cat, ...) \
+    do { \
+        if ((lvl) <= SIM_TRACE && (lvl) <= trace_level && (trace_mask & (cat))) \
+            printf(__VA_ARGS__); \
+    } while (0)
+#else
+#define TRACE(lvl, cat, ...) do { } while (0)
+#endif
+
+/*
+ * Binary per-cycle trace. Each simulated cycle becomes one fixed-size
+ * record, collected in a ring of BTRACE_RING records that is written to
+ * the trace file whenever it fills. tracedump renders a file back to
+ * text or CSV. A record holds one instruction per stage of the scalar
+ * in-order pipe, so the trace is refused for wider pipes and for the
+ * out-of-order core rather than written with instructions missing.
+ */
+
+#define BTRACE_MAGIC   0x54524d41 // "ARMT"
+#define BTRACE_VERSION 1
+#define BTRACE_RING    4096
+#define BTRACE_NAMELEN 24
+
+// Per-cycle events, OR'ed into btrace_events while the cycle runs
+#define TREC_STALL        0x0001 // load-use stall inserted by the HDU
+#define TREC_FLUSH        0x0002 // flush bubble inserted in DE or IF
+#define TREC_FETCH_STALL  0x0004 // fetch waiting on an iCache miss
+#define TREC_MEM_STALL    0x0008 // pipeline frozen on a dCache miss
+#define TREC_ICACHE_HIT   0x0010
+#define TREC_ICACHE_MISS  0x0020
+#define TREC_DCACHE_HIT   0x0040
+#define TREC_DCACHE_MISS  0x0080
+#define TREC_MISS_CANCEL  0x0100 // pending iCache miss dropped on redirect
+#define TREC_BTB_HIT      0x0200 // fetch found the PC in the BTB
+#define TREC_BR_TAKEN     0x0400 // branch resolved taken in EX
+#define TREC_BR_MISPRED   0x0800 // branch resolution redirected fetch
+#define TREC_RETIRE       0x1000 // WB retired an instruction
+#define TREC_HALT         0x2000
+#define TREC_MSHR_MERGE   0x4000 // dCache miss merged into a busy MSHR
+#define TREC_REG_WAIT     0x8000 // EX waiting on a load still in an MSHR
+#define TREC_NEVENTS      16
+
+// Pipeline stages, in the order they are stored in a record
+enum { TS_FETCH, TS_DE, TS_EX, TS_MEM, TS_WB, TS_NSTAGES };
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t rec_size;
+    uint32_t num_ops;
+    uint32_t reserved;
+    // followed by num_ops names of BTRACE_NAMELEN bytes each
+} btrace_header;
+
+// Addresses are stored as 32 bits; the simulated text segment lives
+// well below 4GB. Bubbles carry pc 0.
+typedef struct {
+    uint32_t cycle;
+    uint32_t pc[TS_NSTAGES]; // fetch PC, then the instruction in each stage
+    uint8_t op[TS_NSTAGES]; // opcode per stage (fetch slot unused)
+    uint8_t reserved;
+    uint16_t events; // TREC_*
+} btrace_rec;
+
+extern uint32_t btrace_events;
+#define BTRACE(ev) (btrace_events |= (ev))
+
+/* NULL if a record can describe the configured core, else why not */
+const char* btrace_unsupported();
+
+int btrace_open(const char* filename);
+void btrace_close();
+void btrace_begin_cycle();
+void btrace_end_cycle();
+
+#endif
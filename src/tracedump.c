@@ -0,0 +1,119 @@
+/*
+ * CMSC 22200
+ *
+ * ARM pipeline timing simulator
+ *
+ * tracedump: render a binary trace written by the simulator's
+ * 'btrace' command as the text trace format or as CSV.
+ *
+ *   usage: tracedump [-csv] <trace_file>
+ */
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* event_names[TREC_NEVENTS] = {
+    "stall", "flush", "fetch_stall", "mem_stall",
+    "icache_hit", "icache_miss", "dcache_hit", "dcache_miss",
+    "miss_cancel", "btb_hit", "br_taken", "br_mispred",
+    "retire", "halt", "mshr_merge", "reg_wait",
+};
+
+// Lines the text trace prints for each event, in the same order
+static const char* event_text[TREC_NEVENTS] = {
+    "     stalled", "flushed", "fetch_stalling", "mem stalling",
+    "iCache hit", "iCache miss", "dCache Hit", "dCache miss",
+    "CANCEL CACHE MISS", "bp->HIT", "branch taken", "branch mispredicted.",
+    "retired", "halted", "dCache miss merged", "waiting on load",
+};
+
+static char (*names)[BTRACE_NAMELEN];
+static uint32_t num_ops;
+
+static const char* name_of(uint8_t op) {
+    return op < num_ops ? names[op] : "?";
+}
+
+static void print_text(const btrace_rec* r) {
+    printf("cycle %u\n\n", r->cycle);
+    printf("WB: %s @0x%x\n", name_of(r->op[TS_WB]), r->pc[TS_WB]);
+    printf("MEM: %s @0x%x\n", name_of(r->op[TS_MEM]), r->pc[TS_MEM]);
+    printf("EX: %s @0x%x\n", name_of(r->op[TS_EX]), r->pc[TS_EX]);
+    printf("DE: %s @0x%x\n", name_of(r->op[TS_DE]), r->pc[TS_DE]);
+    printf("FETCH: current_address: 0x%x\n", r->pc[TS_FETCH]);
+    for (int e = 0; e < TREC_NEVENTS; e++) {
+        if (r->events & (1 << e)) {
+            printf("%s\n", event_text[e]);
+        }
+    }
+}
+
+static void print_csv(const btrace_rec* r) {
+    printf("%u,0x%x", r->cycle, r->pc[TS_FETCH]);
+    for (int s = TS_DE; s < TS_NSTAGES; s++) {
+        printf(",0x%x,%s", r->pc[s], name_of(r->op[s]));
+    }
+    printf(",");
+    const char* sep = "";
+    for (int e = 0; e < TREC_NEVENTS; e++) {
+        if (r->events & (1 << e)) {
+            printf("%s%s", sep, event_names[e]);
+            sep = "|";
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    int csv = 0;
+    const char* filename = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-csv") == 0) {
+            csv = 1;
+        } else {
+            filename = argv[i];
+        }
+    }
+    if (filename == NULL) {
+        printf("Error: usage: %s [-csv] <trace_file>\n", argv[0]);
+        exit(1);
+    }
+
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        printf("Error: Can't open trace file %s\n", filename);
+        exit(-1);
+    }
+    btrace_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != BTRACE_MAGIC
+            || hdr.version != BTRACE_VERSION || hdr.rec_size != sizeof(btrace_rec)) {
+        printf("Error: %s is not a version %d trace file\n", filename, BTRACE_VERSION);
+        exit(-1);
+    }
+    num_ops = hdr.num_ops;
+    names = malloc(num_ops * BTRACE_NAMELEN);
+    if (fread(names, BTRACE_NAMELEN, num_ops, f) != num_ops) {
+        printf("Error: Truncated trace file %s\n", filename);
+        exit(-1);
+    }
+
+    if (csv) {
+        printf("cycle,fetch_pc,de_pc,de_op,ex_pc,ex_op,mem_pc,mem_op,wb_pc,wb_op,events\n");
+    }
+    btrace_rec ring[BTRACE_RING];
+    size_t n;
+    while ((n = fread(ring, sizeof(btrace_rec), BTRACE_RING, f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (csv) {
+                print_csv(&ring[i]);
+            } else {
+                print_text(&ring[i]);
+            }
+        }
+    }
+    fclose(f);
+    free(names);
+    return 0;
+}